@@ -41,6 +41,23 @@
 #define SOGV_ATTR_UV_ID 2
 #define SOGV_ATTR_BONE_ID 3
 #define SOGV_ATTR_WEIGHT_ID 4
+// mat4 attributes take four locations each
+#define SOGV_ATTR_INSTANCE_MODEL_ID 5
+#define SOGV_ATTR_INSTANCE_NORMAL_ID 9
+
+// sogv_model_create_ex flags
+#define SOGV_MODEL_FLIP_TEXTURES (1u << 0)
+// Upload sogv_vert_packed instead of sogv_vert; the float verts stay on the CPU side
+#define SOGV_MODEL_PACKED_VERTS (1u << 1)
+// Reorder each mesh for the post-transform vertex cache and vertex fetch (sogv_mesh_optimize)
+#define SOGV_MODEL_OPTIMIZE (1u << 2)
+// With SOGV_MODEL_OPTIMIZE, also order triangle clusters to cut overdraw
+#define SOGV_MODEL_OPTIMIZE_OVERDRAW (1u << 3)
+// Pack all meshes into one VAO/VBO/EBO and draw each material with one glMultiDrawElementsBaseVertex
+#define SOGV_MODEL_SHARED_BUFFERS (1u << 4)
+// Build a chain of simplified index lists per mesh over its own vertices (sogv_mesh_lods)
+#define SOGV_MODEL_LODS (1u << 5)
+#define SOGV_LOD_MAX 6
 
 typedef unsigned int uint;
 
@@ -56,6 +73,17 @@ typedef struct sogv_vert {
     float weights[MAX_BONE_INFLUENCE];
 } sogv_vert;
 
+// Compact vertex layout, 28 bytes: float position, 10-10-10-2 snorm normal, half float uv,
+// unorm8 weights summing to 1 and uint8 bone ids. Bone ids are an integer attribute, so shaders
+// declare them as ivec4/uvec4.
+typedef struct sogv_vert_packed {
+    vec3 pos;
+    uint32_t normal;
+    uint16_t uv[2];
+    uint8_t bone_ids[MAX_BONE_INFLUENCE];
+    uint8_t weights[MAX_BONE_INFLUENCE];
+} sogv_vert_packed;
+
 typedef struct sogv_skel_node {
     char name[64];
     struct sogv_skel_node* children[MAX_BONES];
@@ -79,18 +107,79 @@ typedef struct sogv_skel_anim {
     mat4x4* bone_anim_mats;
 } sogv_skel_anim;
 
+// One detail level of a mesh: a range of its indices and how far it strays from level 0
+typedef struct sogv_mesh_lod {
+    size_t first_index;
+    size_t indice_count;
+    // largest quadric distance of a collapse, in model units
+    float error;
+} sogv_mesh_lod;
+
 typedef struct sogv_mesh {
     sogv_vert* verts;
     uint* indices;
     size_t vert_count;
     size_t indice_count;
     size_t mat_idx;
+    // set by sogv_mesh_pack; uploaded instead of verts when present
+    sogv_vert_packed* packed;
+    // GL_UNSIGNED_SHORT meshes upload short_indices, a 16-bit copy of indices
+    GLenum index_type;
+    unsigned short* short_indices;
+    // where the mesh starts inside its model's shared buffers
+    GLint base_vertex;
+    size_t first_index;
     GLuint vao, vbo, ebo;
+    // model space bounds of the bind pose: box and a sphere around its centre
+    vec3 min, max;
+    vec3 center;
+    float radius;
+    // levels past 0 follow the level 0 indices in indices (and the EBO); indice_count stays
+    // level 0. lod_count is 0 without a chain.
+    sogv_mesh_lod lods[SOGV_LOD_MAX];
+    size_t lod_count;
 } sogv_mesh;
 
+// Meshes of one material in a model's shared buffers, ready for glMultiDrawElementsBaseVertex.
+// With LODs there is a set of batch_count batches per level, level after level.
+typedef struct sogv_draw_batch {
+    size_t mat_idx;
+    GLsizei* counts;
+    const void** offsets;
+    GLint* base_vertices;
+    GLsizei draw_count;
+} sogv_draw_batch;
+
+// Open addressing string -> int map; keys are borrowed, not copied, and must outlive the map
+typedef struct sogv_name_map {
+    const char** keys;
+    uint32_t* hashes;
+    int* values;
+    size_t cap;
+    size_t count;
+} sogv_name_map;
+
+// Simulated FIFO post-transform cache: misses per triangle (ACMR, 0.5 at best) and per
+// vertex used (ATVR, 1.0 at best)
+typedef struct sogv_cache_stats {
+    float acmr;
+    float atvr;
+} sogv_cache_stats;
+
+typedef struct sogv_image {
+    unsigned char* data;
+    int w, h, n;
+    // block-compressed images (KTX/DDS): GL internal format and mip levels packed in data
+    GLenum format;
+    int levels;
+} sogv_image;
+
 typedef struct sogv_model {
     sogv_mesh* meshes;
     GLuint* materials;
+    char** mat_paths;
+    // decoded textures waiting for sogv_model_upload
+    sogv_image* mat_images;
     mat4x4 bones[MAX_BONES];
     char bone_names[MAX_BONES][64];
     sogv_skel_node* root_node;
@@ -99,8 +188,196 @@ typedef struct sogv_model {
     size_t mesh_count;
     size_t mat_count;
     size_t bone_count;
+    uint flags;
+    // union of the meshes' bounds
+    vec3 min, max;
+    vec3 center;
+    float radius;
+    // worst error of each level over the meshes (sogv_model_lod_errors); meshes with shorter
+    // chains repeat their last level
+    float lod_errors[SOGV_LOD_MAX];
+    size_t lod_count;
+    // SOGV_MODEL_SHARED_BUFFERS: one VAO for every mesh; meshes keep no GL objects of their own
+    GLuint vao, vbo, ebo;
+    GLenum index_type;
+    sogv_draw_batch* batches;
+    size_t batch_count;
+    // set when loaded from a baked file; arrays point into it
+    void* blob;
+    sogv_skel_node* node_pool;
+    // ready once GL objects exist; loading while a worker still imports it
+    bool ready;
+    bool loading;
+    bool discarded;
+    // buffers and textures still queued in the upload scheduler
+    size_t uploads_pending;
 } sogv_model;
 
+// World space merge of static instances: one mesh per material in each chunk, chunks cut on a
+// chunk_size grid and bounded by min/max for culling
+typedef struct sogv_static_chunk {
+    vec3 min, max;
+    sogv_mesh* meshes;
+    GLuint* materials;
+    size_t mesh_count;
+} sogv_static_chunk;
+
+typedef struct sogv_static_batch {
+    float chunk_size;
+    struct sogv_static_instance* instances;
+    size_t instance_count;
+    size_t instance_cap;
+    sogv_static_chunk* chunks;
+    size_t chunk_count;
+} sogv_static_batch;
+
+// std140 layout of the per-frame uniform block:
+//     layout(std140) uniform sogv_frame { mat4 view; mat4 proj; mat4 vp; vec4 cam_pos; float time; };
+// and of a skeleton's bone palette:
+//     layout(std140) uniform sogv_bones { mat4 bones_mat[MAX_BONES]; };
+#define SOGV_UBO_FRAME_BLOCK "sogv_frame"
+#define SOGV_UBO_BONES_BLOCK "sogv_bones"
+#define SOGV_UBO_FRAME_BINDING 0
+#define SOGV_UBO_BONES_BINDING 1
+
+typedef struct sogv_frame_data {
+    mat4x4 view;
+    mat4x4 proj;
+    mat4x4 vp;
+    // w unused
+    vec4 cam_pos;
+    float time;
+    float pad[3];
+} sogv_frame_data;
+
+// A uniform block's place in the stream ring; valid until the frame's segment comes around again
+typedef struct sogv_ubo_range {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} sogv_ubo_range;
+
+// Space from sogv_stream_alloc: write size bytes at ptr; GL reads them from buffer at offset
+typedef struct sogv_stream_block {
+    void* ptr;
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} sogv_stream_block;
+
+// One instance of an instanced draw; shaders read it as
+//     layout(location = 5) in mat4 inst_model;
+//     layout(location = 9) in mat4 inst_normal;
+typedef struct sogv_instance_data {
+    mat4x4 model;
+    mat4x4 normal;
+} sogv_instance_data;
+
+// Per-draw data of a multi-draw. GL 3.3 has no gl_DrawID, so a program declaring
+//     uniform samplerBuffer sogv_draw_transforms;  // per draw: model, then normal matrix
+//     uniform isamplerBuffer sogv_draw_bases;      // per draw: base vertex, ascending
+//     uniform int sogv_draw_count, sogv_draw_transform_first, sogv_draw_base_first;
+// finds its draw from gl_VertexID, which includes the base vertex:
+//     int lo = 0, hi = sogv_draw_count - 1;
+//     while(lo < hi) {
+//         int mid = (lo + hi + 1) / 2;
+//         if(texelFetch(sogv_draw_bases, sogv_draw_base_first + mid).x <= gl_VertexID) lo = mid;
+//         else hi = mid - 1;
+//     }
+//     int t = sogv_draw_transform_first + lo*8;
+//     mat4 model = mat4(texelFetch(sogv_draw_transforms, t), texelFetch(sogv_draw_transforms, t+1),
+//                       texelFetch(sogv_draw_transforms, t+2), texelFetch(sogv_draw_transforms, t+3));
+// and the normal matrix from texels t+4 to t+7. The draws of one multi-draw therefore own
+// disjoint vertex ranges, each starting at its base vertex, as the meshes of a shared buffer
+// model do. Only draws of distinct base vertices can share one: repeated submissions of a mesh
+// and every per-mesh VAO model (base vertex 0) pair up with nothing, and the queue draws those
+// one by one with sogv_draw_count 0 and the matrices in the usual "model" and "normal_mat"
+// uniforms, which the program must then read instead.
+#define SOGV_DRAW_TRANSFORMS "sogv_draw_transforms"
+#define SOGV_DRAW_BASES "sogv_draw_bases"
+#define SOGV_DRAW_COUNT "sogv_draw_count"
+#define SOGV_DRAW_TRANSFORM_FIRST "sogv_draw_transform_first"
+#define SOGV_DRAW_BASE_FIRST "sogv_draw_base_first"
+#define SOGV_DRAW_TRANSFORMS_UNIT 14
+#define SOGV_DRAW_BASES_UNIT 15
+
+// Inward facing, normalized planes (left, right, bottom, top, near, far) as a, b, c, d with
+// a*x + b*y + c*z + d >= 0 inside; size_factor > 0 enables small object culling from eye
+typedef struct sogv_frustum {
+    float planes[6][4];
+    vec3 eye;
+    float size_factor;
+} sogv_frustum;
+
+// World space bounds in SoA layout for sogv_cull: box centre and extents, sphere radius
+typedef struct sogv_cull_bounds {
+    float *cx, *cy, *cz;
+    float *ex, *ey, *ez;
+    float *r;
+    size_t count;
+    size_t cap;
+} sogv_cull_bounds;
+
+// Low resolution occlusion buffer for sogv_occlusion_*: the closest occluder per pixel as 1/w
+// (0 where there is none) and the farthest value of each 8x8 tile. w and h are whole tiles.
+typedef struct sogv_occlusion {
+    int w, h;
+    int tiles_x, tiles_y;
+    float* depth;
+    float* tile_min;
+    mat4x4 vp;
+    // occluder triangles set up in screen space, queued until sogv_occlusion_rasterize
+    struct sogv_occluder_tri* tris;
+    size_t tri_count;
+    size_t tri_cap;
+    // per band triangle lists and job arguments
+    uint32_t* band_offsets;
+    uint32_t* band_tris;
+    size_t band_tris_cap;
+    struct sogv_occlusion_band* bands;
+    vec4* scratch;
+    size_t scratch_cap;
+} sogv_occlusion;
+
+// GL calls the state tracker let through and the ones it dropped as redundant
+typedef struct sogv_gl_state_stats {
+    size_t issued;
+    size_t skipped;
+} sogv_gl_state_stats;
+
+// Per drawn object state for hardware occlusion queries: zero it, keep it with the object like
+// its LOD level and release it with sogv_query_object_free
+#define SOGV_QUERY_SLOTS 3
+typedef struct sogv_query_object {
+    GLuint queries[SOGV_QUERY_SLOTS];
+    // frame each slot's box was drawn in, 0 for never
+    uint64_t issued[SOGV_QUERY_SLOTS];
+    // a draw ran under the slot and has not been counted yet
+    bool conditioned[SOGV_QUERY_SLOTS];
+} sogv_query_object;
+
+// Queried draws in the last frame, how many ran under last frame's query and how many boxes
+// were drawn. skipped counts conditional draws the GPU dropped, out of read_back draws whose
+// results came in this frame (a frame or two after they ran).
+typedef struct sogv_query_stats {
+    size_t draws;
+    size_t conditional;
+    size_t proxies;
+    size_t read_back;
+    size_t skipped;
+} sogv_query_stats;
+
+// What the last sogv_queue_flush did: draws submitted, draw calls issued after instancing
+// merged repeats, and the state changes in between
+typedef struct sogv_queue_stats {
+    size_t draws;
+    size_t calls;
+    size_t programs;
+    size_t textures;
+    size_t vaos;
+    size_t transforms;
+} sogv_queue_stats;
+
 typedef struct sogv_cam {
     vec3 position;
     vec3 front;
@@ -144,6 +421,15 @@ typedef struct sogv_base {
 
 char* sogv_read_file(const char* path);
 
+uint32_t sogv_hash_str(const char* str);
+void sogv_name_map_init(sogv_name_map* map, size_t expected);
+void sogv_name_map_free(sogv_name_map* map);
+// Returns false and keeps the old value if key is already in the map
+bool sogv_name_map_add(sogv_name_map* map, const char* key, int value);
+// -1 when key is missing
+int sogv_name_map_get(const sogv_name_map* map, const char* key);
+bool sogv_name_map_remove(sogv_name_map* map, const char* key);
+
 sogv_base sogv_base_create(const char* title, int w, int h, const uint32_t sdl_flags);
 #define sogv_base_loop_start(BASE)                                              \
 {                                                                               \
@@ -166,17 +452,77 @@ void sogv_base_clean(sogv_base* b);
 
 void sogv_gl_check(const char* msg);
 GLuint sogv_gl_shader_create(const char* vertex_path, const char* fragment_path);
-#define sogv_gl_uniform_set_bool(SHADER, UNIFORM, VALUE) glUniform1i(glGetUniformLocation(SHADER, UNIFORM), (int)VALUE)
-#define sogv_gl_uniform_set_int(SHADER, UNIFORM, VALUE) glUniform1i(glGetUniformLocation(SHADER, UNIFORM), VALUE)
-#define sogv_gl_uniform_set_float(SHADER, UNIFORM, VALUE) glUniform1f(glGetUniformLocation(SHADER, UNIFORM), VALUE)
-#define sogv_gl_uniform_set_float2(SHADER, UNIFORM, X, Y) glUniform2f(glGetUniformLocation(SHADER, UNIFORM), X, Y)
-#define sogv_gl_uniform_set_float3(SHADER, UNIFORM, X, Y, Z) glUniform3f(glGetUniformLocation(SHADER, UNIFORM), X, Y, Z)
-#define sogv_gl_uniform_set_float4(SHADER, UNIFORM, X, Y, Z, W) glUniform4f(glGetUniformLocation(SHADER, UNIFORM), X, Y, Z, W)
-#define sogv_gl_uniform_set_vec2(SHADER, UNIFORM, VEC2) glUniform2fv(glGetUniformLocation(SHADER, UNIFORM), 1, &VEC2[0])
-#define sogv_gl_uniform_set_vec3(SHADER, UNIFORM, VEC3) glUniform3fv(glGetUniformLocation(SHADER, UNIFORM), 1, &VEC3[0])
-#define sogv_gl_uniform_set_vec4(SHADER, UNIFORM, VEC4) glUniform4fv(glGetUniformLocation(SHADER, UNIFORM), 1, &VEC4[0])
-#define sogv_gl_uniform_set_mat4x4(SHADER, UNIFORM, MAT4X4) glUniformMatrix4fv(glGetUniformLocation(SHADER, UNIFORM), 1, GL_FALSE, &MAT4X4[0][0])
-#define sogv_gl_uniform_set_mat4x4_v(SHADER, COUNT, UNIFORM, MAT4X4) glUniformMatrix4fv(glGetUniformLocation(SHADER, UNIFORM), COUNT, GL_FALSE, &MAT4X4[0][0])
+GLuint sogv_gl_shader_create_source(const char* vertex_code, const char* fragment_code);
+// Non-blocking creation: submit only starts the compiles and the link and returns the program.
+// Its status is checked, and failures die, when it is first used (sogv_gl_use_program, uniform
+// lookups) or finished by hand. Submitting every program before using any lets
+// KHR_parallel_shader_compile build them side by side. Without that extension ready is always
+// true and the driver may still compile at submit.
+GLuint sogv_gl_shader_submit(const char* vertex_path, const char* fragment_path);
+GLuint sogv_gl_shader_submit_source(const char* vertex_code, const char* fragment_code);
+bool sogv_gl_shader_ready(GLuint program);
+void sogv_gl_shader_finish(GLuint program);
+void sogv_gl_shaders_finish();
+// Program binary cache: with it running, the sogv_gl_shader_create calls load programs
+// from dir (which must exist) and store the ones they compile there. Entries are keyed by
+// both sources plus GL_RENDERER and GL_VERSION. It needs ARB_get_program_binary; without it,
+// or with dir NULL, every program compiles.
+void sogv_gl_program_cache_init(const char* dir);
+void sogv_gl_program_cache_quit();
+// Used by the shader submit calls: load gives 0 on a miss, hint goes before linking
+GLuint sogv_gl_program_cache_load(const char* vertex_code, const char* fragment_code);
+void sogv_gl_program_cache_hint(GLuint program);
+void sogv_gl_program_cache_store(GLuint program, const char* vertex_code, const char* fragment_code);
+
+// Shadowed GL state: each call is skipped when the value is already current. sogv goes through
+// these and leaves its last VAO and textures bound; code that calls GL directly for the same
+// state should call sogv_gl_state_reset afterwards, and unbind the VAO (sogv_gl_bind_vao(0))
+// before binding its own GL_ELEMENT_ARRAY_BUFFER. Textures are GL_TEXTURE_2D on units 0-15.
+void sogv_gl_state_reset();
+void sogv_gl_use_program(GLuint program);
+void sogv_gl_bind_vao(GLuint vao);
+void sogv_gl_bind_texture(GLuint unit, GLuint texture);
+// GL_TEXTURE_BUFFER on the unit, shadowed apart from its 2D texture
+void sogv_gl_bind_texture_buffer(GLuint unit, GLuint texture);
+void sogv_gl_bind_buffer(GLenum target, GLuint buffer);
+void sogv_gl_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void sogv_gl_set_enabled(GLenum cap, bool enabled);
+// Shadowed value when known, glIsEnabled otherwise
+bool sogv_gl_enabled(GLenum cap);
+void sogv_gl_delete_vertex_arrays(GLsizei n, const GLuint* vaos);
+void sogv_gl_delete_buffers(GLsizei n, const GLuint* buffers);
+void sogv_gl_delete_textures(GLsizei n, const GLuint* textures);
+// Counters since the last call
+sogv_gl_state_stats sogv_gl_state_stats_take();
+// Handle into a program's reflected uniforms, -1 if the uniform is not active
+typedef int sogv_uniform;
+// Lists the active uniforms; sogv_gl_shader_create does this, other programs on first lookup
+void sogv_gl_uniforms_reflect(GLuint program);
+void sogv_gl_uniforms_forget(GLuint program);
+// Resolve handles once at setup; "name" and "name[0]" find an array, "name[i]" element i on
+sogv_uniform sogv_gl_uniform_find(GLuint program, const char* name);
+// count elements from the handle's, as floats (float types) or ints (int, bool, samplers). The
+// program must be current; values equal to the last ones set are not sent again.
+void sogv_gl_uniform_set(GLuint program, sogv_uniform u, GLsizei count, const void* value);
+void sogv_gl_uniform_set_by_name(GLuint program, const char* name, GLsizei count, const void* value);
+// On by default; turn off for programs whose uniforms are also set behind sogv's back
+void sogv_gl_uniform_cache_enable(GLuint program, bool enabled);
+// True if the program reads per-instance matrices (sogv_instance_data) instead of uniforms
+bool sogv_gl_program_instanced(GLuint program);
+// True if the program looks up per-draw matrices in SOGV_DRAW_TRANSFORMS
+bool sogv_gl_program_multidraw(GLuint program);
+void sogv_gl_shader_free(GLuint program);
+#define sogv_gl_uniform_set_bool(SHADER, UNIFORM, VALUE) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, (int[]){(int)(VALUE)})
+#define sogv_gl_uniform_set_int(SHADER, UNIFORM, VALUE) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, (int[]){VALUE})
+#define sogv_gl_uniform_set_float(SHADER, UNIFORM, VALUE) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, (float[]){VALUE})
+#define sogv_gl_uniform_set_float2(SHADER, UNIFORM, X, Y) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, (float[]){X, Y})
+#define sogv_gl_uniform_set_float3(SHADER, UNIFORM, X, Y, Z) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, (float[]){X, Y, Z})
+#define sogv_gl_uniform_set_float4(SHADER, UNIFORM, X, Y, Z, W) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, (float[]){X, Y, Z, W})
+#define sogv_gl_uniform_set_vec2(SHADER, UNIFORM, VEC2) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, &VEC2[0])
+#define sogv_gl_uniform_set_vec3(SHADER, UNIFORM, VEC3) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, &VEC3[0])
+#define sogv_gl_uniform_set_vec4(SHADER, UNIFORM, VEC4) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, &VEC4[0])
+#define sogv_gl_uniform_set_mat4x4(SHADER, UNIFORM, MAT4X4) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, 1, &MAT4X4[0][0])
+#define sogv_gl_uniform_set_mat4x4_v(SHADER, COUNT, UNIFORM, MAT4X4) sogv_gl_uniform_set_by_name(SHADER, UNIFORM, COUNT, &MAT4X4[0][0])
 
 #define sogv_gl_tex_parameterize(TYPE, WRAP, MIPMAP, FILTER)         \
 {                                                               \
@@ -186,16 +532,223 @@ GLuint sogv_gl_shader_create(const char* vertex_path, const char* fragment_path)
     glTexParameteri(TYPE, GL_TEXTURE_MAG_FILTER, FILTER);       \
 }                                                               \
 
+void sogv_mesh_pack(sogv_mesh* mesh);
+// Picks the index type for the EBO: 16-bit when every vertex fits, 32-bit otherwise
+void sogv_mesh_index_narrow(sogv_mesh* mesh);
+// Forsyth triangle order, optional overdraw clustering, then vertices in first use order
+void sogv_mesh_optimize(sogv_mesh* mesh, bool overdraw);
+sogv_cache_stats sogv_mesh_cache_stats(const sogv_mesh* mesh, size_t cache_size);
+// Box from the vertex positions, sphere around the box centre; model bounds enclose the meshes'
+void sogv_mesh_bounds(sogv_mesh* mesh);
+void sogv_model_bounds(sogv_model* model);
+// Appends up to SOGV_LOD_MAX-1 simplified levels to indices, each about half the triangles of
+// the one before. Vertices never move, so every level draws from the mesh's own VBO. Run on
+// the float verts before narrowing, packing or upload.
+void sogv_mesh_lods(sogv_mesh* mesh);
+// Level 0 and every LOD level: what the EBO holds
+size_t sogv_mesh_index_total(const sogv_mesh* mesh);
+// Levels past the end of the chain give its last level
+sogv_mesh_lod sogv_mesh_lod_get(const sogv_mesh* mesh, size_t level);
+void sogv_model_lod_errors(sogv_model* model);
+void sogv_mesh_glize(sogv_mesh* mesh);
+// Creates the VAO and sizes the buffers without filling them (for the upload scheduler)
+void sogv_mesh_glize_storage(sogv_mesh* mesh);
+
+// Lays the meshes out back to back and builds the per-material draw batches of
+// SOGV_MODEL_SHARED_BUFFERS (CPU only)
+void sogv_model_batch(sogv_model* model);
+// Filled GL buffers: the shared VAO once batched, one VAO per mesh otherwise
+void sogv_model_glize(sogv_model* model);
+// Creates the shared VAO and sizes its buffers without filling them (for the upload scheduler)
+void sogv_model_glize_shared_storage(sogv_model* model);
+
 sogv_model* sogv_model_create(const char* folder, const char* file);
+sogv_model* sogv_model_create_ex(const char* folder, const char* file, uint flags);
+// sogv_model_create split in two: import does the CPU work (any thread), upload the GL work
+sogv_model* sogv_model_import(const char* folder, const char* file, uint flags);
+// Same as sogv_model_import for a scene already in memory; texture paths are relative to folder
+sogv_model* sogv_model_import_scene(const struct aiScene* scene, const char* folder, uint flags);
+void sogv_model_upload(sogv_model* model);
+// Returns right away; the model renders once sogv_jobs_poll has uploaded it (model->ready)
+sogv_model* sogv_model_create_async(const char* folder, const char* file);
+sogv_model* sogv_model_create_async_ex(const char* folder, const char* file, uint flags);
 void sogv_model_render(sogv_model* model);
+void sogv_model_render_lod(sogv_model* model, size_t level);
+// Draws count copies, one per transform, with a single instanced draw per mesh. The program
+// must take its model and normal matrices from the instance attributes.
+void sogv_model_render_instanced(sogv_model* model, mat4x4* transforms, size_t count);
+void sogv_model_render_instanced_lod(sogv_model* model, size_t level, mat4x4* transforms, size_t count);
+// LOD selection: screen_scale is how many pixels a model unit covers at the model (proj_y is
+// proj[1][1]); select returns the coarsest level whose error stays under max_px, moving off
+// current only past a hysteresis margin (0.2 = 20%). Keep current per drawn object.
+float sogv_model_screen_scale(const sogv_model* model, mat4x4 transform, vec3 eye, float proj_y, float viewport_h);
+size_t sogv_model_lod_select(const sogv_model* model, float screen_scale, float max_px, float hysteresis, size_t current);
 void sogv_model_free(sogv_model* model);
 
+// Static batches: add non-skinned models with fixed transforms, build once on the GL thread,
+// then render with an identity model matrix. visible (one flag per chunk) may be NULL.
+// Building keeps its own texture references, so the source models can be freed afterwards.
+sogv_static_batch* sogv_static_batch_create(float chunk_size);
+bool sogv_static_batch_add(sogv_static_batch* batch, const sogv_model* model, mat4x4 transform);
+void sogv_static_batch_build(sogv_static_batch* batch);
+void sogv_static_batch_render(const sogv_static_batch* batch, const bool* visible);
+void sogv_static_batch_free(sogv_static_batch* batch);
+
+// Render queue: submit draws during the frame, sogv_queue_flush sorts them by program, texture,
+// VAO then depth (front to back) and issues them with the fewest state changes. Programs get
+// "model" and "normal_mat" from each draw's transform; other uniforms are set before flushing.
+void sogv_queue_submit(GLuint program, GLuint texture, GLuint vao, GLenum index_type, GLsizei count,
+        size_t offset, GLint base_vertex, mat4x4 transform, float depth);
+// Queues every mesh of a ready model; depth is the view distance used for ordering
+void sogv_model_submit(const sogv_model* model, GLuint program, mat4x4 transform, float depth);
+void sogv_model_submit_lod(const sogv_model* model, size_t level, GLuint program, mat4x4 transform, float depth);
+void sogv_queue_flush();
+sogv_queue_stats sogv_queue_last_stats();
+void sogv_queue_free();
+
+// Hardware occlusion queries, opt-in per draw. Between sogv_query_frame_begin and _end,
+// sogv_model_render_queried draws like sogv_model_render_lod with the caller's program and
+// uniforms, but under the query the object's bounding box filled last frame; frame_end draws
+// this frame's boxes into new queries, so call it after the opaque scene. Boxes come from the
+// bind pose bounds; objects crossing the near plane are always drawn. frame_end leaves color
+// and depth writes on.
+void sogv_query_frame_begin(mat4x4 vp);
+void sogv_model_render_queried(sogv_model* model, size_t level, mat4x4 transform, sogv_query_object* obj);
+void sogv_query_frame_end();
+sogv_query_stats sogv_query_last_stats();
+void sogv_query_object_free(sogv_query_object* obj);
+void sogv_query_quit();
+
+// Frustum culling; SIMD width follows the build (AVX, SSE, else scalar)
+void sogv_frustum_from_vp(sogv_frustum* f, mat4x4 vp);
+// Also drop objects under min_px pixels across; proj_y is proj[1][1], min_px <= 0 turns it off
+void sogv_frustum_min_size(sogv_frustum* f, vec3 eye, float proj_y, float viewport_h, float min_px);
+size_t sogv_cull_bounds_add(sogv_cull_bounds* b, const vec3 center, const vec3 extents, float radius);
+size_t sogv_cull_bounds_add_model(sogv_cull_bounds* b, const sogv_model* model, mat4x4 transform);
+void sogv_cull_bounds_clear(sogv_cull_bounds* b);
+void sogv_cull_bounds_free(sogv_cull_bounds* b);
+// Returns the visible count. visible_mask gets a bit per object ((count+31)/32 words) and
+// visible_idx the visible indices in order; either may be NULL.
+size_t sogv_cull(const sogv_frustum* f, const sogv_cull_bounds* b, uint32_t* visible_mask, uint32_t* visible_idx);
+
+// Software occlusion culling. Per frame: begin with the view-projection, add the occluders,
+// rasterize (bands of tile rows spread over the worker pool), then test occludees. Occluders
+// should be small, closed or wall-like meshes that sit inside what they stand for.
+sogv_occlusion* sogv_occlusion_create(int w, int h);
+void sogv_occlusion_free(sogv_occlusion* occ);
+void sogv_occlusion_begin(sogv_occlusion* occ, mat4x4 vp);
+// positions are the first three floats of every stride bytes
+void sogv_occlusion_add_occluder(sogv_occlusion* occ, const float* positions, size_t stride, size_t vert_count,
+        const uint* indices, size_t index_count, mat4x4 transform);
+void sogv_occlusion_add_mesh(sogv_occlusion* occ, const sogv_mesh* mesh, mat4x4 transform);
+void sogv_occlusion_rasterize(sogv_occlusion* occ);
+// False only when the world space box is hidden behind rasterized occluders
+bool sogv_occlusion_visible(const sogv_occlusion* occ, const vec3 center, const vec3 extents);
+// Compacts the visible_idx list sogv_cull produced to what is not occluded; returns the new count
+size_t sogv_occlusion_cull(const sogv_occlusion* occ, const sogv_cull_bounds* b, uint32_t* visible_idx, size_t count);
+
+// Baked model files: sogv_vert/index arrays, bones, skeleton and keys as laid out in memory.
+// Loading is one read plus pointer fix-ups; returns NULL if the file is missing or stale.
+// The model's flags are stored too: loading packs, batches and flips textures like the
+// model that was saved.
+#define SOGV_BIN_VERSION 3
+bool sogv_model_save_binary(const sogv_model* model, const char* path);
+sogv_model* sogv_model_load_binary(const char* path);
+
 void sogv_skel_animate(sogv_skel_node* node, float anim_time, mat4x4 parent_mat, mat4x4* bones, mat4x4* bone_anim_mats);
 
 sogv_cam sogv_cam_create(const float pos_x, const float pos_y, const float pos_z, const float mov_spd, const float rot_spd);
 void sogv_cam_handle_events(sogv_cam* cam, const SDL_Event e);
 void sogv_cam_movement(sogv_cam* cam, const float ticks);
 
-GLuint sogv_gl_stb_texture_create(const char* path);
+// Thread safe; flip is per call instead of stbi's global setting
+GLuint sogv_gl_stb_texture_create(const char* path, bool flip);
+bool sogv_image_load(sogv_image* img, const char* path, bool flip);
+void sogv_image_free(sogv_image* img);
+GLuint sogv_gl_image_texture_create(const sogv_image* img);
+
+// KTX 1.1 / DDS containers with S3TC, RGTC or BPTC data and precomputed mips. sogv_image_load
+// and sogv_gl_stb_texture_create take this path for .ktx/.dds files; flip does not apply.
+// S3TC needs EXT_texture_compression_s3tc (and EXT_texture_sRGB for the sRGB ones), BPTC
+// ARB_texture_compression_bptc; files in formats the driver lacks fail to load. The lookup
+// runs on a GL thread, which sogv_base_create does; call probe after making a context current
+// elsewhere.
+void sogv_image_compressed_probe();
+bool sogv_image_is_compressed(const char* path);
+bool sogv_image_load_compressed(sogv_image* img, const char* path);
+size_t sogv_image_level_size(const sogv_image* img, int level);
+
+// Texture cache keyed by cleaned up path. acquire/ref hand out a reference to the shared GL
+// name (acquire loads on a miss, ref returns 0), release drops one and deletes at zero.
+bool sogv_tex_cached(const char* path);
+GLuint sogv_tex_ref(const char* path);
+void sogv_tex_insert(const char* path, GLuint id);
+// flip applies when the texture has to be decoded
+GLuint sogv_tex_acquire(const char* path, bool flip);
+// Like acquire, but uploads an already decoded image on a miss; frees the image either way
+GLuint sogv_tex_acquire_image(const char* path, sogv_image* img, bool flip);
+void sogv_tex_release(GLuint id);
+
+// Worker pool: work runs on a worker thread, done on whichever thread calls sogv_jobs_poll
+// (the GL thread, once per frame). thread_count 0 picks one less than the CPU count.
+typedef void (*sogv_job_fn)(void* arg);
+// Jobs pushed to a group have no done callback; sogv_jobs_wait blocks until all of them ran
+typedef struct sogv_job_group {
+    size_t pending;
+} sogv_job_group;
+void sogv_jobs_init(size_t thread_count);
+void sogv_jobs_quit();
+void sogv_job_push(sogv_job_fn work, sogv_job_fn done, void* arg);
+void sogv_job_push_group(sogv_job_group* group, sogv_job_fn work, void* arg);
+void sogv_jobs_wait(sogv_job_group* group);
+size_t sogv_jobs_poll();
+
+// Upload scheduler: spreads buffer and texture uploads over frames, at most bytes_per_frame
+// or ms_per_frame (0 = unlimited) each. Textures stream through a ring of pbo_count pixel
+// buffers of pbo_size bytes. Models queued with sogv_upload_model turn ready once resident,
+// including textures another model is still streaming; without sogv_upload_init,
+// sogv_upload_model uploads right away. sogv_upload_quit finishes whatever is left.
+void sogv_upload_init(size_t bytes_per_frame, float ms_per_frame, size_t pbo_count, size_t pbo_size);
+void sogv_upload_quit();
+void sogv_upload_model(sogv_model* model);
+void sogv_upload_cancel(sogv_model* model);
+size_t sogv_upload_frame();
+
+// Uniform blocks, allocated from the stream ring (sogv_stream_init) between its frame_begin and
+// frame_end. sogv_gl_shader_create binds the sogv_frame and sogv_bones blocks of every program
+// it links.
+sogv_ubo_range sogv_ubo_push(const void* data, size_t size);
+void sogv_ubo_bind(GLuint binding, sogv_ubo_range range);
+// Writes and binds the per-frame block, once for every program
+void sogv_ubo_set_frame(const sogv_frame_data* frame);
+// Push once per skeleton per frame, then sogv_ubo_bind(SOGV_UBO_BONES_BINDING, range) per character
+sogv_ubo_range sogv_ubo_push_bones(const mat4x4* bones, size_t count);
+void sogv_ubo_program_bind(GLuint program);
+
+// Streaming ring for dynamic data: a segment of bytes_per_frame for each of frames frames in
+// flight, fenced at frame_end. Persistent, coherent mapping where ARB_buffer_storage exists;
+// otherwise blocks are written through an unsynchronized mapping that sogv_stream_flush
+// closes, so flush before any draw or copy that reads them (a no-op when persistent).
+void sogv_stream_init(size_t bytes_per_frame, size_t frames);
+void sogv_stream_quit();
+bool sogv_stream_active();
+void sogv_stream_frame_begin();
+void sogv_stream_frame_end();
+sogv_stream_block sogv_stream_alloc(size_t size, size_t align);
+void sogv_stream_flush();
+
+// Instance stream shared by every sogv VAO. Fill scratch entries, then upload right before
+// each instanced draw; the draw reads instances from the start of the buffer.
+void sogv_instance_attach();
+sogv_instance_data* sogv_instance_scratch(size_t count);
+void sogv_instance_fill(sogv_instance_data* data, mat4x4 transform);
+void sogv_instance_upload(const sogv_instance_data* data, size_t count);
+void sogv_instance_free();
+
+// Buffer textures behind multi-draws: uploads count draws' matrices and ascending base
+// vertices (into the stream ring when it runs), binds them and sets the SOGV_DRAW_* uniforms
+// of program, which must be current
+void sogv_multidraw_upload(GLuint program, const sogv_instance_data* data, const GLint* bases, size_t count);
+void sogv_multidraw_free();
 
 #endif
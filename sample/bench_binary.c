@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include <sogv.h>
+
+// Compares assimp import against the baked format on the same file:
+//   bench_binary ../res/models/animation2/ untitled.gltf [runs]
+
+#define RUNS 10
+
+static double ms_since(uint64_t start) {
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) sogv_die("Usage: bench_binary <folder/> <file> [runs]");
+    const int runs = argc > 3 ? atoi(argv[3]) : RUNS;
+
+    sogv_base game = sogv_base_create("bench_binary", 320, 240, SDL_INIT_VIDEO);
+
+    char baked[512];
+    snprintf(baked, sizeof(baked), "%s%s.sogv", argv[1], argv[2]);
+
+    double assimp_ms = 0.0, binary_ms = 0.0;
+    for(int i=0; i<runs; ++i) {
+        uint64_t start = SDL_GetPerformanceCounter();
+        sogv_model* mod = sogv_model_create_ex(argv[1], argv[2], SOGV_MODEL_FLIP_TEXTURES);
+        glFinish();
+        assimp_ms += ms_since(start);
+
+        if(i==0 && !sogv_model_save_binary(mod, baked)) sogv_die("Could not bake model");
+        sogv_model_free(mod);
+
+        start = SDL_GetPerformanceCounter();
+        mod = sogv_model_load_binary(baked);
+        glFinish();
+        binary_ms += ms_since(start);
+        if(!mod) sogv_die("Could not load baked model");
+        sogv_model_free(mod);
+    }
+
+    printf("assimp: %.3f ms/load\nbinary: %.3f ms/load\nspeedup: %.1fx\n",
+            assimp_ms/runs, binary_ms/runs, assimp_ms/binary_ms);
+
+    sogv_base_clean(&game);
+    return EXIT_SUCCESS;
+}
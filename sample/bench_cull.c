@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include <sogv.h>
+
+// Times sogv_cull over a cloud of unit boxes around the camera:
+//   bench_cull [object count] [min pixels]
+
+#define OBJECT_COUNT 100000
+#define RUNS 100
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : OBJECT_COUNT;
+    const float min_px = argc > 2 ? strtof(argv[2], NULL) : 0.0f;
+
+    mat4x4 proj, view, vp;
+    mat4x4_perspective(proj, sogv_deg_to_rad(90), 16.0f/9.0f, 0.1f, 100.0f);
+    vec3 eye = {0.0f, 0.0f, 0.0f}, at = {0.0f, 0.0f, -1.0f}, up = {0.0f, 1.0f, 0.0f};
+    mat4x4_look_at(view, eye, at, up);
+    mat4x4_mul(vp, proj, view);
+
+    sogv_frustum frustum;
+    sogv_frustum_from_vp(&frustum, vp);
+    sogv_frustum_min_size(&frustum, eye, proj[1][1], 720.0f, min_px);
+
+    sogv_cull_bounds bounds = {0};
+    srand(1);
+    for(size_t i=0; i<count; ++i) {
+        vec3 center = {rand()%200 - 100.0f, rand()%200 - 100.0f, rand()%200 - 100.0f};
+        vec3 extents = {0.5f, 0.5f, 0.5f};
+        sogv_cull_bounds_add(&bounds, center, extents, 0.87f);
+    }
+
+    uint32_t* mask = malloc((count+31)/32*sizeof(uint32_t));
+    uint32_t* idx = malloc(count*sizeof(uint32_t));
+    if(!mask || !idx) sogv_die("Could not allocate cull results");
+
+    size_t visible = 0;
+    uint64_t start = SDL_GetPerformanceCounter();
+    for(size_t r=0; r<RUNS; ++r) visible = sogv_cull(&frustum, &bounds, mask, idx);
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / RUNS;
+
+    fprintf(stderr, "%zu objects, %zu visible, %.3f ms per cull\n", count, visible, ms);
+    free(mask);
+    free(idx);
+    sogv_cull_bounds_free(&bounds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include <sogv.h>
+
+// Reports the LOD chain sogv_mesh_lods builds for every mesh of a model:
+//   bench_lod ../res/models/animation2/ untitled.gltf > /dev/null
+
+int main(int argc, char** argv) {
+    if(argc < 3) sogv_die("Usage: bench_lod <folder/> <file>");
+
+    // the first import only warms up the file cache
+    sogv_model* plain = sogv_model_import(argv[1], argv[2], 0);
+    uint64_t start = SDL_GetPerformanceCounter();
+    sogv_model* lods = sogv_model_import(argv[1], argv[2], SOGV_MODEL_LODS);
+    double lods_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    start = SDL_GetPerformanceCounter();
+    sogv_model* plain_again = sogv_model_import(argv[1], argv[2], 0);
+    double plain_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    fprintf(stderr, "mesh level: tris  share of level 0  error (model units, share of mesh radius)\n");
+    for(size_t i=0; i<lods->mesh_count; ++i) {
+        const sogv_mesh* mesh = &lods->meshes[i];
+        const size_t base_tris = mesh->indice_count/3;
+        for(size_t l=0; l<mesh->lod_count; ++l) {
+            const sogv_mesh_lod* lod = &mesh->lods[l];
+            fprintf(stderr, "%zu %zu: %zu  %5.1f%%  %.5f (%.2f%%)\n", i, l, lod->indice_count/3,
+                    base_tris ? 100.0f * lod->indice_count/3 / base_tris : 0.0f, lod->error,
+                    mesh->radius > 0.0f ? 100.0f * lod->error / mesh->radius : 0.0f);
+        }
+    }
+    fprintf(stderr, "model levels: %zu, errors:", lods->lod_count);
+    for(size_t l=0; l<lods->lod_count; ++l) fprintf(stderr, " %.5f", lods->lod_errors[l]);
+    fprintf(stderr, "\nimport: %.3f ms, with LODs: %.3f ms\n", plain_ms, lods_ms);
+
+    sogv_model_free(plain);
+    sogv_model_free(plain_again);
+    sogv_model_free(lods);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <sogv.h>
+
+// Checks sogv_occlusion on a few known scenes, then times rasterizing a row of occluder
+// boxes and testing a cloud of unit boxes behind them:
+//   bench_occlusion [object count] [buffer width] [buffer height]
+
+#define OBJECT_COUNT 100000
+#define RUNS 100
+
+static const float box_pos[8][3] = {
+    {-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1},
+    {-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}
+};
+static const uint box_idx[36] = {
+    0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+    3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+};
+
+// A box from -1 to 1 scaled by half_size and moved to center
+static void box_transform(mat4x4 out, float x, float y, float z, float hx, float hy, float hz) {
+    mat4x4_translate(out, x, y, z);
+    mat4x4_scale_aniso(out, out, hx, hy, hz);
+}
+
+static bool check(const char* what, bool got, bool want) {
+    fprintf(stderr, "%-34s %s\n", what, got == want ? "ok" : "FAILED");
+    return got == want;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : OBJECT_COUNT;
+    const int w = argc > 2 ? atoi(argv[2]) : 256;
+    const int h = argc > 3 ? atoi(argv[3]) : 128;
+
+    mat4x4 proj, view, vp;
+    mat4x4_perspective(proj, sogv_deg_to_rad(90), 16.0f/9.0f, 0.1f, 100.0f);
+    vec3 eye = {0.0f, 0.0f, 0.0f}, at = {0.0f, 0.0f, -1.0f}, up = {0.0f, 1.0f, 0.0f};
+    mat4x4_look_at(view, eye, at, up);
+    mat4x4_mul(vp, proj, view);
+
+    sogv_occlusion* occ = sogv_occlusion_create(w, h);
+
+    // a 10x10 wall ten units ahead
+    mat4x4 wall;
+    box_transform(wall, 0.0f, 0.0f, -10.0f, 5.0f, 5.0f, 0.1f);
+    sogv_occlusion_begin(occ, vp);
+    sogv_occlusion_add_occluder(occ, box_pos[0], sizeof(box_pos[0]), 8, box_idx, 36, wall);
+    sogv_occlusion_rasterize(occ);
+
+    bool ok = true;
+    const vec3 unit = {0.5f, 0.5f, 0.5f};
+    ok &= check("box behind the wall", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, -20.0f}, unit), false);
+    ok &= check("box in front of the wall", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, -5.0f}, unit), true);
+    ok &= check("box beside the wall", sogv_occlusion_visible(occ, (vec3){12.0f, 0.0f, -20.0f}, unit), true);
+    ok &= check("box peeking past the edge", sogv_occlusion_visible(occ, (vec3){10.2f, 0.0f, -20.0f}, unit), true);
+    ok &= check("box cutting through the wall", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, -10.0f}, unit), true);
+    ok &= check("box around the camera", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, 0.0f}, unit), true);
+    ok &= check("large box far behind", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, -60.0f},
+                (vec3){20.0f, 20.0f, 1.0f}), false);
+
+    // the camera inside an occluder: near clipping must not hide what is in front of it
+    mat4x4 around;
+    box_transform(around, 0.0f, 0.0f, 0.0f, 2.0f, 2.0f, 2.0f);
+    sogv_occlusion_begin(occ, vp);
+    sogv_occlusion_add_occluder(occ, box_pos[0], sizeof(box_pos[0]), 8, box_idx, 36, around);
+    sogv_occlusion_rasterize(occ);
+    ok &= check("box past an occluder around the eye", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, -5.0f}, unit), false);
+    ok &= check("box inside an occluder around the eye", sogv_occlusion_visible(occ, (vec3){0.0f, 0.0f, -1.0f},
+                (vec3){0.2f, 0.2f, 0.2f}), true);
+
+    // timing: a row of buildings with the cloud behind and among them
+    mat4x4 buildings[16];
+    for(int i=0; i<16; ++i)
+        box_transform(buildings[i], -30.0f + i*4.0f, 0.0f, -15.0f - (i%3)*2.0f, 1.8f, 6.0f, 1.8f);
+    sogv_cull_bounds bounds = {0};
+    srand(1);
+    for(size_t i=0; i<count; ++i) {
+        vec3 center = {rand()%100 - 50.0f, rand()%20 - 10.0f, -(rand()%80) - 10.0f};
+        sogv_cull_bounds_add(&bounds, center, unit, 0.87f);
+    }
+    uint32_t* idx = malloc(count*sizeof(uint32_t));
+    if(!idx) sogv_die("Could not allocate cull results");
+
+    sogv_frustum frustum;
+    sogv_frustum_from_vp(&frustum, vp);
+    double raster_ms = 0.0, test_ms = 0.0;
+    size_t in_frustum = 0, visible = 0;
+    for(size_t r=0; r<RUNS; ++r) {
+        uint64_t start = SDL_GetPerformanceCounter();
+        sogv_occlusion_begin(occ, vp);
+        for(int i=0; i<16; ++i)
+            sogv_occlusion_add_occluder(occ, box_pos[0], sizeof(box_pos[0]), 8, box_idx, 36, buildings[i]);
+        sogv_occlusion_rasterize(occ);
+        uint64_t mid = SDL_GetPerformanceCounter();
+        in_frustum = sogv_cull(&frustum, &bounds, NULL, idx);
+        visible = sogv_occlusion_cull(occ, &bounds, idx, in_frustum);
+        uint64_t end = SDL_GetPerformanceCounter();
+        raster_ms += (mid - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        test_ms += (end - mid) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    fprintf(stderr, "%dx%d buffer, %zu occluder triangles\n", occ->w, occ->h, occ->tri_count);
+    fprintf(stderr, "%zu objects, %zu in the frustum, %zu not occluded\n", count, in_frustum, visible);
+    fprintf(stderr, "%.3f ms rasterize, %.3f ms frustum + occlusion tests\n", raster_ms / RUNS, test_ms / RUNS);
+
+    free(idx);
+    sogv_cull_bounds_free(&bounds);
+    sogv_occlusion_free(occ);
+    sogv_jobs_quit();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,35 @@
+#include <stdlib.h>
+#include <sogv.h>
+
+// Reports post-transform cache efficiency of every mesh before and after sogv_mesh_optimize:
+//   bench_opt ../res/models/animation2/ untitled.gltf [cache size] > /dev/null
+
+#define CACHE_SIZE 16
+
+int main(int argc, char** argv) {
+    if(argc < 3) sogv_die("Usage: bench_opt <folder/> <file> [cache size]");
+    const size_t cache_size = argc > 3 ? strtoul(argv[3], NULL, 10) : CACHE_SIZE;
+
+    sogv_model* plain = sogv_model_import(argv[1], argv[2], 0);
+    uint64_t start = SDL_GetPerformanceCounter();
+    sogv_model* opt = sogv_model_import(argv[1], argv[2], SOGV_MODEL_OPTIMIZE);
+    double opt_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    start = SDL_GetPerformanceCounter();
+    sogv_model* overdraw = sogv_model_import(argv[1], argv[2], SOGV_MODEL_OPTIMIZE | SOGV_MODEL_OPTIMIZE_OVERDRAW);
+    double overdraw_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    fprintf(stderr, "cache %zu | mesh: tris  ACMR plain/opt/overdraw  ATVR plain/opt/overdraw\n", cache_size);
+    for(size_t i=0; i<plain->mesh_count; ++i) {
+        sogv_cache_stats a = sogv_mesh_cache_stats(&plain->meshes[i], cache_size);
+        sogv_cache_stats b = sogv_mesh_cache_stats(&opt->meshes[i], cache_size);
+        sogv_cache_stats c = sogv_mesh_cache_stats(&overdraw->meshes[i], cache_size);
+        fprintf(stderr, "%zu: %zu  %.3f/%.3f/%.3f  %.3f/%.3f/%.3f\n", i, plain->meshes[i].indice_count/3,
+                a.acmr, b.acmr, c.acmr, a.atvr, b.atvr, c.atvr);
+    }
+    fprintf(stderr, "import with optimize: %.3f ms, with overdraw: %.3f ms\n", opt_ms, overdraw_ms);
+
+    sogv_model_free(plain);
+    sogv_model_free(opt);
+    sogv_model_free(overdraw);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <sogv.h>
+
+// Times sogv_model_import_scene on synthetic skeletons: every mesh is skinned to all
+// MAX_BONES bones and every node of a wide tree has an animation channel.
+//   bench_skel [meshes] [nodes] > /dev/null
+
+#define MESHES 50
+#define NODES 2000
+#define FANOUT 8
+#define KEYS 4
+
+static void set_name(struct aiString* str, const char* fmt, size_t i) {
+    str->length = snprintf(str->data, sizeof(str->data), fmt, i);
+}
+
+static struct aiScene* synth_scene(size_t mesh_count, size_t node_count) {
+    struct aiScene* scene = calloc(1, sizeof(struct aiScene));
+
+    struct aiNode* nodes = calloc(node_count, sizeof(struct aiNode));
+    for(size_t i=0; i<node_count; ++i) {
+        // first MAX_BONES nodes carry bone names, the rest are helpers
+        set_name(&nodes[i].mName, i < MAX_BONES ? "bone_%zu" : "helper_%zu", i);
+        nodes[i].mChildren = calloc(FANOUT, sizeof(struct aiNode*));
+        if(i>0) {
+            struct aiNode* parent = &nodes[(i-1)/FANOUT];
+            parent->mChildren[parent->mNumChildren++] = &nodes[i];
+            nodes[i].mParent = parent;
+        }
+    }
+    scene->mRootNode = &nodes[0];
+
+    scene->mNumMeshes = mesh_count;
+    scene->mMeshes = calloc(mesh_count, sizeof(struct aiMesh*));
+    for(size_t m=0; m<mesh_count; ++m) {
+        struct aiMesh* mesh = calloc(1, sizeof(struct aiMesh));
+        mesh->mNumVertices = 3;
+        mesh->mVertices = calloc(3, sizeof(struct aiVector3D));
+        mesh->mNumFaces = 1;
+        mesh->mFaces = calloc(1, sizeof(struct aiFace));
+        mesh->mFaces[0].mNumIndices = 3;
+        mesh->mFaces[0].mIndices = calloc(3, sizeof(unsigned int));
+        for(unsigned int i=0; i<3; ++i) mesh->mFaces[0].mIndices[i] = i;
+
+        mesh->mNumBones = MAX_BONES;
+        mesh->mBones = calloc(MAX_BONES, sizeof(struct aiBone*));
+        for(size_t b=0; b<MAX_BONES; ++b) {
+            struct aiBone* bone = calloc(1, sizeof(struct aiBone));
+            set_name(&bone->mName, "bone_%zu", b);
+            bone->mOffsetMatrix.a1 = bone->mOffsetMatrix.b2 = 1.0f;
+            bone->mOffsetMatrix.c3 = bone->mOffsetMatrix.d4 = 1.0f;
+            mesh->mBones[b] = bone;
+        }
+        scene->mMeshes[m] = mesh;
+    }
+
+    struct aiAnimation* anim = calloc(1, sizeof(struct aiAnimation));
+    anim->mDuration = KEYS;
+    anim->mTicksPerSecond = 24.0;
+    anim->mNumChannels = node_count;
+    anim->mChannels = calloc(node_count, sizeof(struct aiNodeAnim*));
+    for(size_t i=0; i<node_count; ++i) {
+        struct aiNodeAnim* channel = calloc(1, sizeof(struct aiNodeAnim));
+        // reverse order so tree walks hit their worst case
+        channel->mNodeName = nodes[node_count-1-i].mName;
+        channel->mNumPositionKeys = channel->mNumScalingKeys = KEYS;
+        channel->mNumRotationKeys = KEYS;
+        channel->mPositionKeys = calloc(KEYS, sizeof(struct aiVectorKey));
+        channel->mScalingKeys = calloc(KEYS, sizeof(struct aiVectorKey));
+        channel->mRotationKeys = calloc(KEYS, sizeof(struct aiQuatKey));
+        anim->mChannels[i] = channel;
+    }
+    scene->mNumAnimations = 1;
+    scene->mAnimations = calloc(1, sizeof(struct aiAnimation*));
+    scene->mAnimations[0] = anim;
+
+    return scene;
+}
+
+int main(int argc, char** argv) {
+    const size_t mesh_count = argc > 1 ? strtoul(argv[1], NULL, 10) : MESHES;
+    const size_t node_count = argc > 2 ? strtoul(argv[2], NULL, 10) : NODES;
+    if(node_count < MAX_BONES) sogv_die_v("Need at least %d nodes", MAX_BONES);
+
+    // the synthetic scene is leaked on purpose, the process ends right after
+    struct aiScene* scene = synth_scene(mesh_count, node_count);
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    sogv_model* mod = sogv_model_import_scene(scene, "", 0);
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    fprintf(stderr, "%zu meshes x %d bones, %zu nodes/channels: %.3f ms (model has %zu bones)\n",
+            mesh_count, MAX_BONES, node_count, ms, mod->bone_count);
+    sogv_model_free(mod);
+    return EXIT_SUCCESS;
+}
@@ -14,24 +14,29 @@ int main() {
             SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
 
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    sogv_gl_set_enabled(GL_DEPTH_TEST, true);
+    sogv_gl_set_enabled(GL_CULL_FACE, true);
 
-    stbi_set_flip_vertically_on_load(true);
+    sogv_upload_init(4*1024*1024, 2.0f, 3, 1024*1024);
+    sogv_stream_init(1024*1024, 3);
+    sogv_gl_program_cache_init("../res/shaders/cache");
 
-    sogv_model* mod = sogv_model_create("../res/models/animation2/", "untitled.gltf");
-    sogv_model* mod2 = sogv_model_create("../res/models/static/", "untitled.gltf");
+    sogv_model* mod = sogv_model_create_ex("../res/models/animation2/", "untitled.gltf",
+            SOGV_MODEL_FLIP_TEXTURES);
+    sogv_model* mod2 = sogv_model_create_async_ex("../res/models/static/", "untitled.gltf",
+            SOGV_MODEL_FLIP_TEXTURES | SOGV_MODEL_LODS);
+    size_t mod2_lod = 0;
 
     sogv_cam cam = sogv_cam_create(0.0f, 0.0f, 3.0f, 2.5f, 50.0f);
 
     mat4x4 proj;
     mat4x4_perspective(proj, sogv_deg_to_rad(FOV), (float)WIDTH/(float)HEIGHT, 0.1f, 100.0f);
 
-    GLuint shader = sogv_gl_shader_create("../res/shaders/normal_shader.vert",
+    GLuint shader = sogv_gl_shader_submit("../res/shaders/normal_shader.vert",
             "../res/shaders/normal_shader.frag");
-    GLuint shader2 = sogv_gl_shader_create("/home/mar/newgl/gltf-loading/res/shaders/normal_shader.vert",
+    GLuint shader2 = sogv_gl_shader_submit("/home/mar/newgl/gltf-loading/res/shaders/normal_shader.vert",
             "/home/mar/newgl/gltf-loading/res/shaders/normal_shader.frag");
-    glUseProgram(shader);
+    sogv_gl_use_program(shader);
     
     /*
     sogv_gl_uniform_set_float3(shader, "light.direction", -0.2f, -1.0f, -0.3f);
@@ -58,6 +63,9 @@ int main() {
             sogv_cam_handle_events(&cam, game.sdl_event);
         }
         sogv_base_loop_start(game);
+        sogv_jobs_poll();
+        sogv_upload_frame();
+        sogv_stream_frame_begin();
 
         sogv_cam_movement(&cam, game.elapsed_ticks);
 
@@ -66,55 +74,54 @@ int main() {
         vec3_add(cam_view, cam.position, cam.front);
         mat4x4_look_at(view, cam.position, cam_view, cam.up);
 
-        mat4x4 vp;
-        mat4x4_mul(vp, proj, view);
-
-        mat4x4 model, model_normal;
+        // view and projection go to every program through the sogv_frame block
+        sogv_frame_data frame;
+        mat4x4_dup(frame.view, view);
+        mat4x4_dup(frame.proj, proj);
+        mat4x4_mul(frame.vp, proj, view);
+        vec4 cam_pos = {cam.position[0], cam.position[1], cam.position[2], 1.0f};
+        vec4_dup(frame.cam_pos, cam_pos);
+        frame.time = game.current_tick / 1000.0f;
+        sogv_ubo_set_frame(&frame);
+
+        mat4x4 model;
         mat4x4_identity(model);
 
-        mat4x4_invert(model_normal, model);
-        mat4x4_transpose(model_normal, model_normal);
-
         //mat4x4_translate_in_place(model, 0.0f, -1.5f, 0.0f);
 
-        mat4x4 bones;
-        mat4x4_identity(bones);
-
-        glUseProgram(shader);
-        char name[64];
-        for(size_t i=0; i<MAX_BONES; ++i) {
-            sprintf(name, "bones_mat[%zu]", i);
-            sogv_gl_uniform_set_mat4x4(shader, name, bones);
-        }
-
         mat4x4 test;
         mat4x4_identity(test);
         anim_time += game.elapsed_ticks*mod->anim_ticks;
         if(anim_time>=mod->anim_dur) anim_time -= mod->anim_dur;
         sogv_skel_animate(mod->root_node, anim_time, test, mod->bones, anim);
-        sogv_gl_uniform_set_mat4x4_v(shader, mod->bone_count, "bones_mat[0]", anim[0]);
-
-        sogv_gl_uniform_set_mat4x4(shader, "vp", vp);
-        sogv_gl_uniform_set_mat4x4(shader, "model", model);
-        sogv_gl_uniform_set_mat4x4(shader, "normal_mat", model_normal);
-        sogv_model_render(mod);
+        sogv_ubo_bind(SOGV_UBO_BONES_BINDING, sogv_ubo_push_bones(anim, mod->bone_count));
 
-        glUseProgram(shader2);
-        mat4x4 model2, model_normal2;
+        mat4x4 model2;
         mat4x4_identity(model2);
         mat4x4_translate(model2, -2.0f, 0.0f, 0.0f);
 
-        mat4x4_invert(model_normal2, model2);
-        mat4x4_transpose(model_normal2, model_normal2);
-        sogv_gl_uniform_set_mat4x4(shader2, "vp", vp);
-        sogv_gl_uniform_set_mat4x4(shader2, "model", model2);
-        sogv_gl_uniform_set_mat4x4(shader2, "normal_mat", model_normal2);
-        sogv_model_render(mod2);
-
+        // the queue sets model/normal_mat per draw and orders the two programs itself
+        vec3 to_cam;
+        vec3_sub(to_cam, model[3], cam.position);
+        sogv_model_submit(mod, shader, model, vec3_len(to_cam));
+        // at most a pixel of simplification error on screen, 20% hysteresis
+        mod2_lod = sogv_model_lod_select(mod2, sogv_model_screen_scale(mod2, model2, cam.position, proj[1][1], HEIGHT),
+                1.0f, 0.2f, mod2_lod);
+        vec3_sub(to_cam, model2[3], cam.position);
+        sogv_model_submit_lod(mod2, mod2_lod, shader2, model2, vec3_len(to_cam));
+        sogv_queue_flush();
+
+        sogv_stream_frame_end();
         sogv_base_loop_end(game);
     }
 
     sogv_model_free(mod);
+    sogv_model_free(mod2);
+    sogv_queue_free();
+    sogv_jobs_quit();
+    sogv_upload_quit();
+    sogv_stream_quit();
+    sogv_gl_program_cache_quit();
     sogv_base_clean(&game);
     
     return EXIT_SUCCESS;
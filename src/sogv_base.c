@@ -87,6 +87,7 @@ static void sdl_gl_create_context(SDL_Window** window, SDL_GLContext* context, c
         if(!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress))
             exit(EXIT_FAILURE);
     #endif
+    sogv_image_compressed_probe();
 
     glViewport(0, 0, width, height);
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -146,96 +147,270 @@ void sogv_gl_check(const char* msg) {
         printf("[GL]\t%s when %s.\n", gl_parse_err(code), msg);
 }
 
+// Compiles and links are only started here. Status queries make the driver finish the
+// program, so they wait for sogv_gl_shader_finish, which the first use of a submitted program
+// runs on its own; with KHR_parallel_shader_compile the programs submitted up to then build
+// side by side on the driver's threads. glGetError can stall as well, so sogv_gl_check runs
+// once per finished program.
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+    #define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+    #define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP shader_max_threads_fn)(GLuint count);
+
+typedef struct shader_pending {
+    GLuint program;
+    GLuint vertex, fragment;
+    // kept for the program binary cache
+    char* vertex_code;
+    char* fragment_code;
+} shader_pending;
+
+static struct {
+    shader_pending* pending;
+    size_t count;
+    size_t cap;
+    bool parallel;
+    bool probed;
+} shaders;
+
+static void gl_shader_parallel_probe() {
+    if(shaders.probed) return;
+    shaders.probed = true;
+    // the ARB version has the same enums and differs only in the name
+    shader_max_threads_fn max_threads = NULL;
+    if(SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile"))
+        max_threads = (shader_max_threads_fn)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if(SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile"))
+        max_threads = (shader_max_threads_fn)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+    if(!max_threads) return;
+    // as many threads as the driver likes
+    max_threads(0xFFFFFFFFu);
+    shaders.parallel = true;
+    sogv_log("Shaders compile in parallel");
+}
+
 static GLuint gl_shader_compile(const GLenum type, const char* code) {
     GLuint shader = glCreateShader(type);
-    int success;
-    char gl_log[1024];
-
     glShaderSource(shader, 1, &code, NULL);
     glCompileShader(shader);
-    sogv_gl_check("compiling shader");
+    return shader;
+}
 
+static void gl_shader_compile_check(const GLuint shader) {
+    int success;
+    char gl_log[1024];
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if(!success)
-        glGetShaderInfoLog(shader, 512, NULL, gl_log),
+        glGetShaderInfoLog(shader, sizeof(gl_log), NULL, gl_log),
         sogv_die_v("Compiling shader failed: %s", gl_log);
+}
 
-    sogv_gl_check("shader should have compiled");
-    sogv_gl_check("activating texture");
-    return shader;
+static GLuint gl_shader_link(const GLuint vertex, const GLuint fragment) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    sogv_gl_program_cache_hint(program);
+    glLinkProgram(program);
+    return program;
 }
 
-static void gl_shader_link(GLuint* shader, const GLuint vertex, const GLuint fragment) {
+static void gl_shader_link_check(const GLuint program) {
     int success;
     char gl_log[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success)
+        glGetProgramInfoLog(program, sizeof(gl_log), NULL, gl_log),
+        sogv_die_v("Linking shader program failed: %s", gl_log);
+}
 
-    *shader = glCreateProgram();
+static void gl_shader_done(GLuint program) {
     sogv_gl_check("creating shader program");
+    sogv_ubo_program_bind(program);
+    sogv_gl_uniforms_reflect(program);
+}
 
-    glAttachShader(*shader, vertex);
-    sogv_gl_check("attaching vertex shader");
-    glAttachShader(*shader, fragment);
-    sogv_gl_check("attaching fragment shader");
+static shader_pending* gl_shader_pending_find(GLuint program) {
+    for(size_t i=0; i<shaders.count; ++i)
+        if(shaders.pending[i].program == program) return &shaders.pending[i];
+    return NULL;
+}
 
-    glLinkProgram(*shader);
-    sogv_gl_check("linking shader program");
+static void gl_shader_pending_remove(shader_pending* p) {
+    glDeleteShader(p->vertex);
+    glDeleteShader(p->fragment);
+    free(p->vertex_code);
+    free(p->fragment_code);
+    *p = shaders.pending[--shaders.count];
+    if(!shaders.count) {
+        free(shaders.pending);
+        shaders.pending = NULL;
+        shaders.cap = 0;
+    }
+}
 
-    glGetProgramiv(*shader, GL_LINK_STATUS, &success);
-    if(!success)
-        glGetProgramInfoLog(*shader, 512, NULL, gl_log),
-        sogv_die_v("Linking shader program failed: %s", gl_log);
+// Takes the sources over
+static GLuint gl_shader_submit(char* vertex_code, char* fragment_code) {
+    GLuint new = sogv_gl_program_cache_load(vertex_code, fragment_code);
+    if(new) {
+        free(vertex_code);
+        free(fragment_code);
+        gl_shader_done(new);
+        return new;
+    }
 
-    sogv_gl_check("shader program should have linked");
+    gl_shader_parallel_probe();
+    shader_pending p = {
+        .vertex = gl_shader_compile(GL_VERTEX_SHADER, vertex_code),
+        .fragment = gl_shader_compile(GL_FRAGMENT_SHADER, fragment_code),
+        .vertex_code = vertex_code,
+        .fragment_code = fragment_code,
+    };
+    p.program = gl_shader_link(p.vertex, p.fragment);
+    if(shaders.count == shaders.cap) {
+        shaders.cap = shaders.cap ? shaders.cap*2 : 16;
+        sogv_arr_resize(shader_pending, shaders.pending, shaders.cap*sizeof(shader_pending));
+    }
+    shaders.pending[shaders.count++] = p;
+    return p.program;
 }
 
-GLuint sogv_gl_shader_create(const char* vertex_path, const char* fragment_path) {
-    GLuint new;
+GLuint sogv_gl_shader_submit(const char* vertex_path, const char* fragment_path) {
+    return gl_shader_submit(sogv_read_file(vertex_path), sogv_read_file(fragment_path));
+}
 
-    char* vertex_code = sogv_read_file(vertex_path);
-    GLuint vertex_shader = gl_shader_compile(GL_VERTEX_SHADER, vertex_code);
-    free(vertex_code);
+GLuint sogv_gl_shader_submit_source(const char* vertex_code, const char* fragment_code) {
+    char* vertex = strdup(vertex_code);
+    char* fragment = strdup(fragment_code);
+    if(!vertex || !fragment) sogv_die("Could not allocate shader source");
+    return gl_shader_submit(vertex, fragment);
+}
 
-    char* fragment_code = sogv_read_file(fragment_path);
-    GLuint fragment_shader = gl_shader_compile(GL_FRAGMENT_SHADER, fragment_code);
-    free(fragment_code);
+bool sogv_gl_shader_ready(GLuint program) {
+    if(!shaders.parallel || !gl_shader_pending_find(program)) return true;
+    GLint done = GL_FALSE;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+    return done;
+}
 
-    gl_shader_link(&new, vertex_shader, fragment_shader);
+void sogv_gl_shader_finish(GLuint program) {
+    shader_pending* p = gl_shader_pending_find(program);
+    if(!p) return;
+    // a failed link says little, so the compile logs come first
+    gl_shader_compile_check(p->vertex);
+    gl_shader_compile_check(p->fragment);
+    gl_shader_link_check(program);
+    sogv_gl_program_cache_store(program, p->vertex_code, p->fragment_code);
+    gl_shader_pending_remove(p);
+    gl_shader_done(program);
+}
 
-    glDeleteShader(vertex_shader);
-    sogv_gl_check("deleting vertex shader");
+void sogv_gl_shaders_finish() {
+    while(shaders.count) sogv_gl_shader_finish(shaders.pending[shaders.count-1].program);
+}
 
-    glDeleteShader(fragment_shader);
-    sogv_gl_check("deleting fragment shader");
+GLuint sogv_gl_shader_create(const char* vertex_path, const char* fragment_path) {
+    GLuint new = sogv_gl_shader_submit(vertex_path, fragment_path);
+    sogv_gl_shader_finish(new);
+    return new;
+}
 
+GLuint sogv_gl_shader_create_source(const char* vertex_code, const char* fragment_code) {
+    GLuint new = sogv_gl_shader_submit_source(vertex_code, fragment_code);
+    sogv_gl_shader_finish(new);
     return new;
 }
 
-GLuint sogv_gl_stb_texture_create(const char* path) {
+void sogv_gl_shader_free(GLuint program) {
+    shader_pending* p = gl_shader_pending_find(program);
+    if(p) gl_shader_pending_remove(p);
+    sogv_gl_uniforms_forget(program);
+    glDeleteProgram(program);
+}
+
+bool sogv_image_load(sogv_image* img, const char* path, bool flip) {
+    if(sogv_image_is_compressed(path)) return sogv_image_load_compressed(img, path);
+    img->format = 0;
+    img->levels = 1;
+    #ifdef STBI_THREAD_LOCAL
+        stbi_set_flip_vertically_on_load_thread(flip);
+        img->data = stbi_load(path, &img->w, &img->h, &img->n, 0);
+    #else
+        // without thread locals the global setting and the decode reading it go together
+        static SDL_SpinLock flip_lock;
+        SDL_AtomicLock(&flip_lock);
+        stbi_set_flip_vertically_on_load(flip);
+        img->data = stbi_load(path, &img->w, &img->h, &img->n, 0);
+        SDL_AtomicUnlock(&flip_lock);
+    #endif
+    if(!img->data) return false;
+    if(img->n != 1 && img->n != 3 && img->n != 4) {
+        sogv_log_v("STBI stumbled upon strange image format when loading: %s", path);
+        sogv_image_free(img);
+        return false;
+    }
+    sogv_log_v("STBI loaded %s!", path);
+    return true;
+}
+
+void sogv_image_free(sogv_image* img) {
+    if(img->format) free(img->data);
+    else stbi_image_free(img->data);
+    img->data = NULL;
+}
+
+static GLuint gl_compressed_texture_create(const sogv_image* img) {
     GLuint id;
     glGenTextures(1, &id);
+    sogv_gl_bind_texture(0, id);
+
+    const unsigned char* level_data = img->data;
+    for(int l=0; l<img->levels; ++l) {
+        int w = img->w >> l, h = img->h >> l;
+        size_t len = sogv_image_level_size(img, l);
+        glCompressedTexImage2D(GL_TEXTURE_2D, l, img->format, w ? w : 1, h ? h : 1, 0, len, level_data);
+        level_data += len;
+    }
+    sogv_gl_check("compressed tex image2d");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, img->levels-1);
+    sogv_gl_tex_parameterize(GL_TEXTURE_2D, GL_REPEAT,
+            img->levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR);
+    return id;
+}
 
-    int w, h, n;
-    unsigned char* data = stbi_load(path, &w, &h, &n, 0);
-    if(data) {
-        sogv_log_v("STBI loaded %s! Binding into GL..", path);
-        GLenum f;
-        switch(n) {
-            case 1: f = GL_RED; break;
-            case 3: f = GL_RGB; break;
-            case 4: f = GL_RGBA; break;
-            default: sogv_die_v("STBI stumbled upon strange image format when loading: %s", path); break;
-        }
-        glBindTexture(GL_TEXTURE_2D, id);
-        glTexImage2D(GL_TEXTURE_2D, 0, f, w, h, 0, f, GL_UNSIGNED_BYTE, data);
-        sogv_gl_check("tex image2d");
-        glGenerateMipmap(GL_TEXTURE_2D);
-        sogv_gl_tex_parameterize(GL_TEXTURE_2D, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-        sogv_gl_check("parametearierhzeir");
-        stbi_image_free(data);
-    } else {
-        stbi_image_free(data);
-        sogv_die_v("STBI could not load image: %s", path);
+GLuint sogv_gl_image_texture_create(const sogv_image* img) {
+    if(img->format) return gl_compressed_texture_create(img);
+
+    GLuint id;
+    glGenTextures(1, &id);
+
+    GLenum f;
+    switch(img->n) {
+        case 1: f = GL_RED; break;
+        case 3: f = GL_RGB; break;
+        default: f = GL_RGBA; break;
     }
+    sogv_gl_bind_texture(0, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, f, img->w, img->h, 0, f, GL_UNSIGNED_BYTE, img->data);
+    sogv_gl_check("tex image2d");
+    glGenerateMipmap(GL_TEXTURE_2D);
+    sogv_gl_tex_parameterize(GL_TEXTURE_2D, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    sogv_gl_check("parametearierhzeir");
+
+    return id;
+}
+
+GLuint sogv_gl_stb_texture_create(const char* path, bool flip) {
+    sogv_image img = {0};
+    if(!sogv_image_load(&img, path, flip))
+        sogv_die_v("Could not load image: %s", path);
+
+    sogv_log_v("Binding %s into GL..", path);
+    GLuint id = sogv_gl_image_texture_create(&img);
+    sogv_image_free(&img);
 
     return id;
 }
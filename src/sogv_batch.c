@@ -0,0 +1,210 @@
+#include <sogv.h>
+
+// Static batching: non-skinned model instances are baked into world space and merged per
+// material, one sogv_mesh per (chunk, material). Instances go to chunks by the grid cell of
+// their bounds' centre, so chunks stay compact enough to cull.
+
+typedef struct sogv_static_instance {
+    const sogv_model* model;
+    mat4x4 transform;
+    vec3 min, max;
+    int cell[3];
+} sogv_static_instance;
+
+sogv_static_batch* sogv_static_batch_create(float chunk_size) {
+    sogv_static_batch* batch = calloc(1, sizeof(sogv_static_batch));
+    if(!batch) sogv_die("Could not allocate static batch");
+    batch->chunk_size = chunk_size > 0.0f ? chunk_size : 1.0f;
+    return batch;
+}
+
+static void batch_transform_point(vec3 out, mat4x4 m, const float* p) {
+    vec4 in = {p[0], p[1], p[2], 1.0f}, r;
+    mat4x4_mul_vec4(r, m, in);
+    out[0] = r[0];
+    out[1] = r[1];
+    out[2] = r[2];
+}
+
+bool sogv_static_batch_add(sogv_static_batch* batch, const sogv_model* model, mat4x4 transform) {
+    if(model->loading || model->bone_count > 0) {
+        sogv_log("Static batches only take loaded, non-skinned models");
+        return false;
+    }
+    if(batch->instance_count == batch->instance_cap) {
+        batch->instance_cap = batch->instance_cap ? batch->instance_cap*2 : 64;
+        sogv_arr_resize(sogv_static_instance, batch->instances, batch->instance_cap*sizeof(sogv_static_instance));
+    }
+    sogv_static_instance* inst = &batch->instances[batch->instance_count++];
+    inst->model = model;
+    mat4x4_dup(inst->transform, transform);
+
+    // world bounds from the eight corners of the model space box
+    const float* lo = model->min;
+    const float* hi = model->max;
+    vec3_dup(inst->min, (vec3){INFINITY, INFINITY, INFINITY});
+    vec3_dup(inst->max, (vec3){-INFINITY, -INFINITY, -INFINITY});
+    for(int c=0; c<8 && lo[0] <= hi[0]; ++c) {
+        vec3 corner = {c&1 ? hi[0] : lo[0], c&2 ? hi[1] : lo[1], c&4 ? hi[2] : lo[2]}, w;
+        batch_transform_point(w, inst->transform, corner);
+        vec3_min(inst->min, inst->min, w);
+        vec3_max(inst->max, inst->max, w);
+    }
+    for(size_t k=0; k<3; ++k)
+        inst->cell[k] = lo[0] <= hi[0] ?
+            (int)floorf((inst->min[k] + inst->max[k]) * 0.5f / batch->chunk_size) : 0;
+    return true;
+}
+
+static int batch_cell_cmp(const void* a, const void* b) {
+    const int* ca = ((const sogv_static_instance*)a)->cell;
+    const int* cb = ((const sogv_static_instance*)b)->cell;
+    for(size_t k=0; k<3; ++k)
+        if(ca[k] != cb[k]) return ca[k] < cb[k] ? -1 : 1;
+    return 0;
+}
+
+static size_t batch_material(sogv_static_chunk* chunk, GLuint tex, size_t cap) {
+    size_t m = 0;
+    while(m < chunk->mesh_count && chunk->materials[m] != tex) m++;
+    if(m == chunk->mesh_count) {
+        if(m == cap) sogv_die("Static batch material table overflow");
+        chunk->materials[chunk->mesh_count++] = tex;
+    }
+    return m;
+}
+
+// Bakes one run of same-cell instances into a chunk
+static void batch_build_chunk(sogv_static_chunk* chunk, sogv_static_instance* insts, size_t count) {
+    size_t cap = 0;
+    for(size_t i=0; i<count; ++i) cap += insts[i].model->mesh_count;
+    chunk->materials = calloc(cap ? cap : 1, sizeof(GLuint));
+    chunk->meshes = calloc(cap ? cap : 1, sizeof(sogv_mesh));
+    chunk->mesh_count = 0;
+    vec3_dup(chunk->min, insts[0].min);
+    vec3_dup(chunk->max, insts[0].max);
+
+    // first pass sizes each material's mesh
+    for(size_t i=0; i<count; ++i) {
+        const sogv_model* model = insts[i].model;
+        vec3_min(chunk->min, chunk->min, insts[i].min);
+        vec3_max(chunk->max, chunk->max, insts[i].max);
+        for(size_t j=0; j<model->mesh_count; ++j) {
+            const sogv_mesh* src = &model->meshes[j];
+            size_t m = batch_material(chunk, model->materials[src->mat_idx], cap);
+            chunk->meshes[m].vert_count += src->vert_count;
+            chunk->meshes[m].indice_count += src->indice_count;
+        }
+    }
+    for(size_t m=0; m<chunk->mesh_count; ++m) {
+        sogv_mesh* dst = &chunk->meshes[m];
+        dst->verts = calloc(dst->vert_count, sizeof(sogv_vert));
+        dst->indices = malloc(dst->indice_count * sizeof(uint));
+        if(!dst->verts || !dst->indices) sogv_die("Could not allocate static batch");
+        dst->mat_idx = m;
+        dst->vert_count = dst->indice_count = 0;
+    }
+
+    for(size_t i=0; i<count; ++i) {
+        const sogv_model* model = insts[i].model;
+        mat4x4 normal_mat;
+        mat4x4_invert(normal_mat, insts[i].transform);
+        mat4x4_transpose(normal_mat, normal_mat);
+
+        for(size_t j=0; j<model->mesh_count; ++j) {
+            const sogv_mesh* src = &model->meshes[j];
+            sogv_mesh* dst = &chunk->meshes[batch_material(chunk, model->materials[src->mat_idx], cap)];
+            for(size_t v=0; v<src->vert_count; ++v) {
+                sogv_vert* out = &dst->verts[dst->vert_count + v];
+                vec4 n = {src->verts[v].normal[0], src->verts[v].normal[1], src->verts[v].normal[2], 0.0f}, wn;
+                batch_transform_point(out->pos, insts[i].transform, src->verts[v].pos);
+                mat4x4_mul_vec4(wn, normal_mat, n);
+                vec3_norm(out->normal, wn);
+                vec2_dup(out->uv, src->verts[v].uv);
+            }
+            for(size_t k=0; k<src->indice_count; ++k)
+                dst->indices[dst->indice_count + k] = src->indices[k] + dst->vert_count;
+            dst->vert_count += src->vert_count;
+            dst->indice_count += src->indice_count;
+        }
+    }
+
+    // the batch holds its own texture references, so source models may be freed after building
+    for(size_t m=0; m<chunk->mesh_count; ++m) {
+        const GLuint tex = chunk->materials[m];
+        chunk->materials[m] = 0;
+        for(size_t i=0; i<count && tex && !chunk->materials[m]; ++i) {
+            const sogv_model* model = insts[i].model;
+            for(size_t j=0; j<model->mat_count; ++j)
+                if(model->materials[j] == tex && model->mat_paths[j]) {
+                    chunk->materials[m] = sogv_tex_ref(model->mat_paths[j]);
+                    break;
+                }
+        }
+    }
+}
+
+void sogv_static_batch_build(sogv_static_batch* batch) {
+    if(!batch->instance_count) return;
+    qsort(batch->instances, batch->instance_count, sizeof(sogv_static_instance), batch_cell_cmp);
+
+    size_t chunk_count = 0;
+    for(size_t i=0; i<batch->instance_count; ++i)
+        if(i == 0 || batch_cell_cmp(&batch->instances[i-1], &batch->instances[i]) != 0) chunk_count++;
+    sogv_arr_resize(sogv_static_chunk, batch->chunks, (batch->chunk_count+chunk_count)*sizeof(sogv_static_chunk));
+
+    size_t draws = 0;
+    for(size_t first=0, i=1; i<=batch->instance_count; ++i) {
+        if(i < batch->instance_count && batch_cell_cmp(&batch->instances[first], &batch->instances[i]) == 0)
+            continue;
+        sogv_static_chunk* chunk = &batch->chunks[batch->chunk_count++];
+        batch_build_chunk(chunk, &batch->instances[first], i-first);
+        for(size_t m=0; m<chunk->mesh_count; ++m) {
+            sogv_mesh_optimize(&chunk->meshes[m], false);
+            sogv_mesh_index_narrow(&chunk->meshes[m]);
+            sogv_mesh_glize(&chunk->meshes[m]);
+        }
+        draws += chunk->mesh_count;
+        first = i;
+    }
+    sogv_log_v("Static batch: %zu instances in %zu chunks, %zu draws",
+            batch->instance_count, batch->chunk_count, draws);
+
+    free(batch->instances);
+    batch->instances = NULL;
+    batch->instance_count = batch->instance_cap = 0;
+}
+
+void sogv_static_batch_render(const sogv_static_batch* batch, const bool* visible) {
+    for(size_t c=0; c<batch->chunk_count; ++c) {
+        if(visible && !visible[c]) continue;
+        const sogv_static_chunk* chunk = &batch->chunks[c];
+        for(size_t m=0; m<chunk->mesh_count; ++m) {
+            const sogv_mesh* mesh = &chunk->meshes[m];
+            sogv_gl_bind_texture(0, chunk->materials[m]);
+            sogv_gl_bind_vao(mesh->vao);
+            glDrawElements(GL_TRIANGLES, mesh->indice_count, mesh->index_type, 0);
+        }
+    }
+}
+
+void sogv_static_batch_free(sogv_static_batch* batch) {
+    for(size_t c=0; c<batch->chunk_count; ++c) {
+        sogv_static_chunk* chunk = &batch->chunks[c];
+        for(size_t m=0; m<chunk->mesh_count; ++m) {
+            sogv_mesh* mesh = &chunk->meshes[m];
+            free(mesh->verts);
+            free(mesh->indices);
+            free(mesh->short_indices);
+            sogv_gl_delete_vertex_arrays(1, &mesh->vao);
+            sogv_gl_delete_buffers(1, &mesh->vbo);
+            sogv_gl_delete_buffers(1, &mesh->ebo);
+            sogv_tex_release(chunk->materials[m]);
+        }
+        free(chunk->meshes);
+        free(chunk->materials);
+    }
+    free(batch->chunks);
+    free(batch->instances);
+    free(batch);
+}
@@ -0,0 +1,360 @@
+#include <sogv.h>
+
+// Baked model layout (all offsets from file start, every block 16 byte aligned):
+//   bin_header | data blocks (verts, indices, keys, paths) | bones | names | tables
+// Files are written in host order and tagged; only little-endian hosts read or write them.
+
+#define SOGV_BIN_MAGIC "SOGV"
+#define SOGV_BIN_ENDIAN_TAG 0x01020304u
+#define SOGV_BIN_ALIGN 16
+
+typedef struct bin_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t vert_size;
+    uint32_t mesh_count;
+    uint32_t mat_count;
+    uint32_t bone_count;
+    uint32_t node_count;
+    // SOGV_MODEL_* flags of the saved model
+    uint32_t flags;
+    uint32_t reserved;
+    float anim_dur;
+    float anim_ticks;
+    uint64_t file_size;
+    uint64_t meshes_off;
+    uint64_t mats_off;
+    uint64_t bones_off;
+    uint64_t bone_names_off;
+    uint64_t nodes_off;
+    uint64_t children_off;
+} bin_header;
+
+typedef struct bin_mesh {
+    uint64_t verts_off;
+    uint64_t indices_off;
+    uint32_t vert_count;
+    uint32_t indice_count;
+    uint32_t mat_idx;
+    // LOD levels follow level 0 in the index block; 0 without a chain
+    uint32_t lod_count;
+    uint32_t lod_indice_counts[SOGV_LOD_MAX];
+    float lod_errors[SOGV_LOD_MAX];
+} bin_mesh;
+
+typedef struct bin_mat {
+    uint64_t path_off;
+} bin_mat;
+
+typedef struct bin_node {
+    char name[64];
+    int32_t bone_idx;
+    uint32_t child_count;
+    uint32_t child_first;
+    uint32_t pos_keys_count;
+    uint32_t rot_keys_count;
+    uint32_t sca_keys_count;
+    uint64_t pos_keys_off;
+    uint64_t rot_keys_off;
+    uint64_t sca_keys_off;
+    uint64_t pos_key_times_off;
+    uint64_t rot_key_times_off;
+    uint64_t sca_key_times_off;
+} bin_node;
+
+typedef struct bin_writer {
+    unsigned char* data;
+    size_t size;
+    size_t cap;
+} bin_writer;
+
+static bool bin_host_little_endian() {
+    const uint32_t tag = 1;
+    return *(const unsigned char*)&tag == 1;
+}
+
+static uint64_t bin_push(bin_writer* w, const void* src, size_t len) {
+    size_t off = (w->size + SOGV_BIN_ALIGN-1) & ~(size_t)(SOGV_BIN_ALIGN-1);
+    if(off+len > w->cap) {
+        size_t cap = w->cap ? w->cap : 4096;
+        while(cap < off+len) cap *= 2;
+        sogv_arr_resize(unsigned char, w->data, cap);
+        w->cap = cap;
+    }
+    memset(w->data + w->size, 0, off - w->size);
+    if(len) memcpy(w->data + off, src, len);
+    w->size = off+len;
+    return off;
+}
+
+static size_t bin_node_count(const sogv_skel_node* node) {
+    size_t count = 1;
+    for(size_t i=0; i<node->child_count; ++i)
+        count += bin_node_count(node->children[i]);
+    return count;
+}
+
+// Pre-order flatten; each node reserves its child index slots before recursing.
+static uint32_t bin_node_flatten(const sogv_skel_node* node, const sogv_skel_node** list,
+        uint32_t* child_idx, uint32_t* child_first, size_t* n, size_t* c) {
+    uint32_t idx = (*n)++;
+    list[idx] = node;
+    size_t first = *c;
+    child_first[idx] = first;
+    *c += node->child_count;
+    for(size_t i=0; i<node->child_count; ++i)
+        child_idx[first+i] = bin_node_flatten(node->children[i], list, child_idx, child_first, n, c);
+    return idx;
+}
+
+bool sogv_model_save_binary(const sogv_model* model, const char* path) {
+    if(!bin_host_little_endian()) {
+        sogv_log("Baked models are little-endian only, not saving");
+        return false;
+    }
+
+    bin_writer w = {0};
+    bin_header header = {0};
+    memcpy(header.magic, SOGV_BIN_MAGIC, 4);
+    header.version = SOGV_BIN_VERSION;
+    header.endian_tag = SOGV_BIN_ENDIAN_TAG;
+    header.vert_size = sizeof(sogv_vert);
+    header.mesh_count = model->mesh_count;
+    header.mat_count = model->mat_count;
+    header.bone_count = model->bone_count;
+    header.flags = model->flags;
+    header.anim_dur = model->anim_dur;
+    header.anim_ticks = model->anim_ticks;
+    bin_push(&w, &header, sizeof(bin_header));
+
+    bin_mesh* meshes = calloc(model->mesh_count, sizeof(bin_mesh));
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        const sogv_mesh* mesh = &model->meshes[i];
+        meshes[i].verts_off = bin_push(&w, mesh->verts, mesh->vert_count*sizeof(sogv_vert));
+        meshes[i].indices_off = bin_push(&w, mesh->indices, sogv_mesh_index_total(mesh)*sizeof(uint));
+        meshes[i].vert_count = mesh->vert_count;
+        meshes[i].indice_count = mesh->indice_count;
+        meshes[i].mat_idx = mesh->mat_idx;
+        meshes[i].lod_count = mesh->lod_count;
+        for(size_t l=0; l<mesh->lod_count; ++l) {
+            meshes[i].lod_indice_counts[l] = mesh->lods[l].indice_count;
+            meshes[i].lod_errors[l] = mesh->lods[l].error;
+        }
+    }
+
+    bin_mat* mats = calloc(model->mat_count, sizeof(bin_mat));
+    for(size_t i=0; i<model->mat_count; ++i)
+        if(model->mat_paths && model->mat_paths[i])
+            mats[i].path_off = bin_push(&w, model->mat_paths[i], strlen(model->mat_paths[i])+1);
+
+    size_t node_count = model->root_node ? bin_node_count(model->root_node) : 0;
+    bin_node* nodes = calloc(node_count, sizeof(bin_node));
+    uint32_t* child_idx = calloc(node_count, sizeof(uint32_t));
+    if(node_count) {
+        const sogv_skel_node** list = calloc(node_count, sizeof(sogv_skel_node*));
+        uint32_t* child_first = calloc(node_count, sizeof(uint32_t));
+        size_t n = 0, c = 0;
+        bin_node_flatten(model->root_node, list, child_idx, child_first, &n, &c);
+
+        for(size_t i=0; i<node_count; ++i) {
+            const sogv_skel_node* node = list[i];
+            bin_node* out = &nodes[i];
+            memcpy(out->name, node->name, 64);
+            out->bone_idx = node->bone_idx;
+            out->child_count = node->child_count;
+            out->child_first = child_first[i];
+            out->pos_keys_count = node->pos_keys_count;
+            out->rot_keys_count = node->rot_keys_count;
+            out->sca_keys_count = node->sca_keys_count;
+            out->pos_keys_off = bin_push(&w, node->pos_keys, node->pos_keys_count*sizeof(vec3));
+            out->rot_keys_off = bin_push(&w, node->rot_keys, node->rot_keys_count*sizeof(quat));
+            out->sca_keys_off = bin_push(&w, node->sca_keys, node->sca_keys_count*sizeof(vec3));
+            out->pos_key_times_off = bin_push(&w, node->pos_key_times, node->pos_keys_count*sizeof(float));
+            out->rot_key_times_off = bin_push(&w, node->rot_key_times, node->rot_keys_count*sizeof(float));
+            out->sca_key_times_off = bin_push(&w, node->sca_key_times, node->sca_keys_count*sizeof(float));
+        }
+        free(child_first);
+        free(list);
+    }
+
+    header.node_count = node_count;
+    header.bones_off = bin_push(&w, model->bones, model->bone_count*sizeof(mat4x4));
+    header.bone_names_off = bin_push(&w, model->bone_names, model->bone_count*64);
+    header.meshes_off = bin_push(&w, meshes, model->mesh_count*sizeof(bin_mesh));
+    header.mats_off = bin_push(&w, mats, model->mat_count*sizeof(bin_mat));
+    header.nodes_off = bin_push(&w, nodes, node_count*sizeof(bin_node));
+    header.children_off = bin_push(&w, child_idx, node_count*sizeof(uint32_t));
+    header.file_size = w.size;
+    memcpy(w.data, &header, sizeof(bin_header));
+
+    free(meshes);
+    free(mats);
+    free(nodes);
+    free(child_idx);
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file && fwrite(w.data, w.size, 1, file) == 1;
+    if(file) fclose(file);
+    if(!ok) sogv_log_v("Could not write baked model %s", path);
+    free(w.data);
+    return ok;
+}
+
+static bool bin_range_ok(const bin_header* header, uint64_t off, uint64_t len) {
+    return off <= header->file_size && len <= header->file_size - off;
+}
+
+sogv_model* sogv_model_load_binary(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if(!file) return NULL;
+
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    unsigned char* blob = NULL;
+    if(size >= (long)sizeof(bin_header) && (blob = malloc(size)))
+        if(fread(blob, size, 1, file) != 1) free(blob), blob = NULL;
+    fclose(file);
+    if(!blob) {
+        sogv_log_v("Could not read baked model %s", path);
+        return NULL;
+    }
+
+    const bin_header* header = (const bin_header*)blob;
+    if(memcmp(header->magic, SOGV_BIN_MAGIC, 4)!=0 || header->version != SOGV_BIN_VERSION
+            || header->endian_tag != SOGV_BIN_ENDIAN_TAG || header->vert_size != sizeof(sogv_vert)
+            || header->file_size != (uint64_t)size || header->bone_count > MAX_BONES
+            || !bin_range_ok(header, header->meshes_off, header->mesh_count*sizeof(bin_mesh))
+            || !bin_range_ok(header, header->mats_off, header->mat_count*sizeof(bin_mat))
+            || !bin_range_ok(header, header->bones_off, header->bone_count*sizeof(mat4x4))
+            || !bin_range_ok(header, header->bone_names_off, header->bone_count*64)
+            || !bin_range_ok(header, header->nodes_off, header->node_count*sizeof(bin_node))
+            || !bin_range_ok(header, header->children_off, header->node_count*sizeof(uint32_t))) {
+        sogv_log_v("Baked model %s is stale or broken", path);
+        free(blob);
+        return NULL;
+    }
+
+    const bin_mesh* meshes = (const bin_mesh*)(blob + header->meshes_off);
+    const bin_mat* mats = (const bin_mat*)(blob + header->mats_off);
+    const bin_node* nodes = (const bin_node*)(blob + header->nodes_off);
+    const uint32_t* child_idx = (const uint32_t*)(blob + header->children_off);
+
+    for(size_t i=0; i<header->mesh_count; ++i) {
+        uint64_t index_total = meshes[i].indice_count;
+        bool lods_ok = meshes[i].lod_count <= SOGV_LOD_MAX
+            && (!meshes[i].lod_count || meshes[i].lod_indice_counts[0] == meshes[i].indice_count);
+        for(size_t l=1; lods_ok && l<meshes[i].lod_count; ++l)
+            index_total += meshes[i].lod_indice_counts[l];
+        if(!lods_ok || !bin_range_ok(header, meshes[i].verts_off, meshes[i].vert_count*sizeof(sogv_vert))
+                || !bin_range_ok(header, meshes[i].indices_off, index_total*sizeof(uint))
+                || (header->mat_count && meshes[i].mat_idx >= header->mat_count)) {
+            sogv_log_v("Baked model %s has broken mesh %zu", path, i);
+            free(blob);
+            return NULL;
+        }
+        // CPU passes (cache stats, static batching) index verts with these unchecked
+        const uint* indices = (const uint*)(blob + meshes[i].indices_off);
+        for(uint64_t j=0; j<index_total; ++j)
+            if(indices[j] >= meshes[i].vert_count) {
+                sogv_log_v("Baked model %s has broken mesh %zu", path, i);
+                free(blob);
+                return NULL;
+            }
+    }
+
+    // Children always come after their parent in pre-order, which also rules out cycles.
+    for(size_t i=0; i<header->node_count; ++i) {
+        const bin_node* in = &nodes[i];
+        bool ok = in->child_count <= MAX_BONES && in->child_first <= header->node_count
+            && in->bone_idx >= -1 && in->bone_idx < (int32_t)header->bone_count
+            && in->child_count <= header->node_count - in->child_first
+            && bin_range_ok(header, in->pos_keys_off, in->pos_keys_count*sizeof(vec3))
+            && bin_range_ok(header, in->rot_keys_off, in->rot_keys_count*sizeof(quat))
+            && bin_range_ok(header, in->sca_keys_off, in->sca_keys_count*sizeof(vec3))
+            && bin_range_ok(header, in->pos_key_times_off, in->pos_keys_count*sizeof(float))
+            && bin_range_ok(header, in->rot_key_times_off, in->rot_keys_count*sizeof(float))
+            && bin_range_ok(header, in->sca_key_times_off, in->sca_keys_count*sizeof(float));
+        for(size_t j=0; ok && j<in->child_count; ++j)
+            ok = child_idx[in->child_first+j] > i && child_idx[in->child_first+j] < header->node_count;
+        if(!ok) {
+            sogv_log_v("Baked model %s has broken node %zu", path, i);
+            free(blob);
+            return NULL;
+        }
+    }
+
+    sogv_model* _model = calloc(1, sizeof(sogv_model));
+    _model->blob = blob;
+    _model->mesh_count = header->mesh_count;
+    _model->mat_count = header->mat_count;
+    _model->bone_count = header->bone_count;
+    _model->flags = header->flags;
+    _model->anim_dur = header->anim_dur;
+    _model->anim_ticks = header->anim_ticks;
+    memcpy(_model->bones, blob + header->bones_off, header->bone_count*sizeof(mat4x4));
+    memcpy(_model->bone_names, blob + header->bone_names_off, header->bone_count*64);
+
+    _model->meshes = calloc(_model->mesh_count, sizeof(sogv_mesh));
+    for(size_t i=0; i<_model->mesh_count; ++i) {
+        sogv_mesh* mesh = &_model->meshes[i];
+        mesh->verts = (sogv_vert*)(blob + meshes[i].verts_off);
+        mesh->indices = (uint*)(blob + meshes[i].indices_off);
+        mesh->vert_count = meshes[i].vert_count;
+        mesh->indice_count = meshes[i].indice_count;
+        mesh->mat_idx = meshes[i].mat_idx;
+        mesh->lod_count = meshes[i].lod_count;
+        for(size_t l=0, first=0; l<mesh->lod_count; ++l) {
+            mesh->lods[l] = (sogv_mesh_lod){
+                .first_index = first,
+                .indice_count = meshes[i].lod_indice_counts[l],
+                .error = meshes[i].lod_errors[l],
+            };
+            first += mesh->lods[l].indice_count;
+        }
+        sogv_mesh_index_narrow(mesh);
+        if(_model->flags & SOGV_MODEL_PACKED_VERTS) sogv_mesh_pack(mesh);
+        sogv_mesh_bounds(mesh);
+    }
+    sogv_model_bounds(_model);
+    sogv_model_lod_errors(_model);
+    if(_model->flags & SOGV_MODEL_SHARED_BUFFERS) sogv_model_batch(_model);
+    sogv_model_glize(_model);
+
+    _model->materials = calloc(_model->mat_count, sizeof(GLuint));
+    _model->mat_paths = calloc(_model->mat_count, sizeof(char*));
+    for(size_t i=0; i<_model->mat_count; ++i)
+        if(mats[i].path_off) {
+            _model->mat_paths[i] = (char*)(blob + mats[i].path_off);
+            _model->materials[i] = sogv_tex_acquire(_model->mat_paths[i], _model->flags & SOGV_MODEL_FLIP_TEXTURES);
+        }
+
+    if(header->node_count) {
+        _model->node_pool = calloc(header->node_count, sizeof(sogv_skel_node));
+        for(size_t i=0; i<header->node_count; ++i) {
+            const bin_node* in = &nodes[i];
+            sogv_skel_node* node = &_model->node_pool[i];
+            memcpy(node->name, in->name, 64);
+            node->name[63] = '\0';
+            node->bone_idx = in->bone_idx;
+            node->child_count = in->child_count;
+            for(size_t j=0; j<node->child_count; ++j)
+                node->children[j] = &_model->node_pool[child_idx[in->child_first+j]];
+            node->pos_keys_count = in->pos_keys_count;
+            node->rot_keys_count = in->rot_keys_count;
+            node->sca_keys_count = in->sca_keys_count;
+            node->pos_keys = (vec3*)(blob + in->pos_keys_off);
+            node->rot_keys = (quat*)(blob + in->rot_keys_off);
+            node->sca_keys = (vec3*)(blob + in->sca_keys_off);
+            node->pos_key_times = (float*)(blob + in->pos_key_times_off);
+            node->rot_key_times = (float*)(blob + in->rot_key_times_off);
+            node->sca_key_times = (float*)(blob + in->sca_key_times_off);
+        }
+        _model->root_node = &_model->node_pool[0];
+    }
+
+    _model->ready = true;
+    return _model;
+}
@@ -0,0 +1,161 @@
+#include <sogv.h>
+
+// Frustum culling of bounds kept in SoA arrays, a SIMD register of objects per step: AVX or SSE
+// on x86-64, scalar elsewhere. Each object has a box (centre, extents)
+// and a sphere (same centre, radius); against each plane the smaller of the two is used, which
+// is exact for either volume. Objects whose projected sphere is under min_px can go too.
+
+// Each kernel is sogv_cull_kernel.h built with one set of cull_* operations. x86-64 always has
+// SSE; the AVX kernel is compiled for AVX on its own and picked at runtime, so plain builds
+// still get it on machines that have it.
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define CULL_X86
+#endif
+
+// Rows of a column-major matrix combined per Gribb & Hartmann; normals point inside
+void sogv_frustum_from_vp(sogv_frustum* f, mat4x4 vp) {
+    for(int p=0; p<6; ++p) {
+        const int row = p/2;
+        const float sign = p%2 ? -1.0f : 1.0f;
+        float len = 0.0f;
+        for(int k=0; k<4; ++k) f->planes[p][k] = vp[k][3] + sign*vp[k][row];
+        for(int k=0; k<3; ++k) len += f->planes[p][k]*f->planes[p][k];
+        len = len > 0.0f ? 1.0f / sqrtf(len) : 0.0f;
+        for(int k=0; k<4; ++k) f->planes[p][k] *= len;
+    }
+    f->size_factor = 0.0f;
+}
+
+// Projected radius in pixels is radius * proj_y * viewport_h / 2 / distance; comparing squares
+// keeps the square root out of the loop
+void sogv_frustum_min_size(sogv_frustum* f, vec3 eye, float proj_y, float viewport_h, float min_px) {
+    vec3_dup(f->eye, eye);
+    if(min_px <= 0.0f) {
+        f->size_factor = 0.0f;
+        return;
+    }
+    float k = proj_y * viewport_h * 0.5f / min_px;
+    f->size_factor = k*k;
+}
+
+void sogv_cull_bounds_clear(sogv_cull_bounds* b) {
+    b->count = 0;
+}
+
+void sogv_cull_bounds_free(sogv_cull_bounds* b) {
+    free(b->cx);
+    memset(b, 0, sizeof(sogv_cull_bounds));
+}
+
+// All seven arrays live in one allocation, each rounded up to a whole SIMD step
+static void cull_bounds_grow(sogv_cull_bounds* b) {
+    size_t cap = b->cap ? b->cap*2 : 256;
+    float* block = calloc(cap*7, sizeof(float));
+    if(!block) sogv_die("Could not allocate cull bounds");
+    float** arrays[7] = {&b->cx, &b->cy, &b->cz, &b->ex, &b->ey, &b->ez, &b->r};
+    for(size_t a=0; a<7; ++a) {
+        if(b->count) memcpy(block + a*cap, *arrays[a], b->count*sizeof(float));
+    }
+    free(b->cx);
+    for(size_t a=0; a<7; ++a) *arrays[a] = block + a*cap;
+    b->cap = cap;
+}
+
+size_t sogv_cull_bounds_add(sogv_cull_bounds* b, const vec3 center, const vec3 extents, float radius) {
+    if(b->count == b->cap) cull_bounds_grow(b);
+    size_t i = b->count++;
+    b->cx[i] = center[0];
+    b->cy[i] = center[1];
+    b->cz[i] = center[2];
+    b->ex[i] = extents[0];
+    b->ey[i] = extents[1];
+    b->ez[i] = extents[2];
+    b->r[i] = radius;
+    return i;
+}
+
+// World bounds of a transformed box: centre moves with the matrix, extents through its absolute
+// 3x3 part; the sphere scales by the largest axis scale
+size_t sogv_cull_bounds_add_model(sogv_cull_bounds* b, const sogv_model* model, mat4x4 transform) {
+    vec3 half, center, extents;
+    vec3_sub(half, model->max, model->min);
+    vec3_scale(half, half, 0.5f);
+    float max_scale2 = 0.0f;
+    for(int row=0; row<3; ++row) {
+        center[row] = transform[3][row];
+        extents[row] = 0.0f;
+        for(int col=0; col<3; ++col) {
+            center[row] += transform[col][row] * model->center[col];
+            extents[row] += fabsf(transform[col][row]) * half[col];
+        }
+    }
+    for(int col=0; col<3; ++col) {
+        float s2 = vec3_mul_inner(transform[col], transform[col]);
+        if(s2 > max_scale2) max_scale2 = s2;
+    }
+    return sogv_cull_bounds_add(b, center, extents, model->radius * sqrtf(max_scale2));
+}
+
+#ifdef CULL_X86
+    #define CULL_NAME cull_avx
+    #define CULL_ATTR __attribute__((target("avx")))
+    #define CULL_W 8
+    #define cull_f __m256
+    #define cull_m __m256
+    #define cull_load(P) _mm256_loadu_ps(P)
+    #define cull_set(X) _mm256_set1_ps(X)
+    #define cull_add(A, B) _mm256_add_ps(A, B)
+    #define cull_sub(A, B) _mm256_sub_ps(A, B)
+    #define cull_mul(A, B) _mm256_mul_ps(A, B)
+    #define cull_min(A, B) _mm256_min_ps(A, B)
+    #define cull_lt(A, B) _mm256_cmp_ps(A, B, _CMP_LT_OQ)
+    #define cull_or(A, B) _mm256_or_ps(A, B)
+    #define cull_none() _mm256_setzero_ps()
+    #define cull_bits(M) ((uint32_t)_mm256_movemask_ps(M))
+    #include "sogv_cull_kernel.h"
+
+    #define CULL_NAME cull_sse
+    #define CULL_ATTR
+    #define CULL_W 4
+    #define cull_f __m128
+    #define cull_m __m128
+    #define cull_load(P) _mm_loadu_ps(P)
+    #define cull_set(X) _mm_set1_ps(X)
+    #define cull_add(A, B) _mm_add_ps(A, B)
+    #define cull_sub(A, B) _mm_sub_ps(A, B)
+    #define cull_mul(A, B) _mm_mul_ps(A, B)
+    #define cull_min(A, B) _mm_min_ps(A, B)
+    #define cull_lt(A, B) _mm_cmplt_ps(A, B)
+    #define cull_or(A, B) _mm_or_ps(A, B)
+    #define cull_none() _mm_setzero_ps()
+    #define cull_bits(M) ((uint32_t)_mm_movemask_ps(M))
+    #include "sogv_cull_kernel.h"
+#else
+    #define CULL_NAME cull_scalar
+    #define CULL_ATTR
+    #define CULL_W 1
+    #define cull_f float
+    #define cull_m uint32_t
+    #define cull_load(P) (*(P))
+    #define cull_set(X) (X)
+    #define cull_add(A, B) ((A) + (B))
+    #define cull_sub(A, B) ((A) - (B))
+    #define cull_mul(A, B) ((A) * (B))
+    #define cull_min(A, B) ((A) < (B) ? (A) : (B))
+    #define cull_lt(A, B) ((uint32_t)((A) < (B)))
+    #define cull_or(A, B) ((A) | (B))
+    #define cull_none() 0u
+    #define cull_bits(M) (M)
+    #include "sogv_cull_kernel.h"
+#endif
+
+size_t sogv_cull(const sogv_frustum* f, const sogv_cull_bounds* b, uint32_t* visible_mask, uint32_t* visible_idx) {
+#ifdef CULL_X86
+    static int has_avx = -1;
+    if(has_avx < 0) has_avx = SDL_HasAVX();
+    return has_avx ? cull_avx(f, b, visible_mask, visible_idx) : cull_sse(f, b, visible_mask, visible_idx);
+#else
+    return cull_scalar(f, b, visible_mask, visible_idx);
+#endif
+}
@@ -0,0 +1,68 @@
+// Frustum cull kernel, included by sogv_cull.c once per SIMD width. The includer defines
+// CULL_NAME, CULL_ATTR, CULL_W, the cull_f (floats) and cull_m (lane mask) types and the cull_*
+// operations.
+
+static CULL_ATTR size_t CULL_NAME(const sogv_frustum* f, const sogv_cull_bounds* b, uint32_t* visible_mask,
+        uint32_t* visible_idx) {
+    if(visible_mask) memset(visible_mask, 0, (b->count+31)/32*sizeof(uint32_t));
+
+    cull_f n[6][4], an[6][3];
+    for(int p=0; p<6; ++p) {
+        for(int k=0; k<4; ++k) n[p][k] = cull_set(f->planes[p][k]);
+        for(int k=0; k<3; ++k) an[p][k] = cull_set(fabsf(f->planes[p][k]));
+    }
+    const bool by_size = f->size_factor > 0.0f;
+    const cull_f eye_x = cull_set(f->eye[0]), eye_y = cull_set(f->eye[1]), eye_z = cull_set(f->eye[2]);
+    const cull_f size_factor = cull_set(f->size_factor);
+    const cull_f zero = cull_set(0.0f);
+
+    size_t visible = 0;
+    // arrays are padded to the capacity, so the last step may read past count; those lanes are masked
+    for(size_t i=0; i<b->count; i+=CULL_W) {
+        const cull_f cx = cull_load(b->cx+i), cy = cull_load(b->cy+i), cz = cull_load(b->cz+i);
+        const cull_f ex = cull_load(b->ex+i), ey = cull_load(b->ey+i), ez = cull_load(b->ez+i);
+        const cull_f r = cull_load(b->r+i);
+        cull_m out = cull_none();
+
+        if(by_size) {
+            cull_f dx = cull_sub(cx, eye_x), dy = cull_sub(cy, eye_y), dz = cull_sub(cz, eye_z);
+            cull_f d2 = cull_add(cull_add(cull_mul(dx, dx), cull_mul(dy, dy)), cull_mul(dz, dz));
+            out = cull_or(out, cull_lt(cull_mul(cull_mul(r, r), size_factor), d2));
+        }
+        for(int p=0; p<6; ++p) {
+            cull_f dist = cull_add(cull_add(cull_mul(n[p][0], cx), cull_mul(n[p][1], cy)),
+                                   cull_add(cull_mul(n[p][2], cz), n[p][3]));
+            cull_f box = cull_add(cull_add(cull_mul(an[p][0], ex), cull_mul(an[p][1], ey)), cull_mul(an[p][2], ez));
+            out = cull_or(out, cull_lt(cull_add(dist, cull_min(box, r)), zero));
+        }
+
+        uint32_t bits = ~cull_bits(out) & ((1u << CULL_W) - 1);
+        if(b->count - i < CULL_W) bits &= (1u << (b->count - i)) - 1;
+        if(visible_mask) visible_mask[i/32] |= bits << (i%32);
+        if(!visible_idx) {
+            visible += __builtin_popcount(bits);
+            continue;
+        }
+        while(bits) {
+            visible_idx[visible++] = i + __builtin_ctz(bits);
+            bits &= bits-1;
+        }
+    }
+    return visible;
+}
+
+#undef CULL_NAME
+#undef CULL_ATTR
+#undef CULL_W
+#undef cull_f
+#undef cull_m
+#undef cull_load
+#undef cull_set
+#undef cull_add
+#undef cull_sub
+#undef cull_mul
+#undef cull_min
+#undef cull_lt
+#undef cull_or
+#undef cull_none
+#undef cull_bits
@@ -0,0 +1,98 @@
+#include <sogv.h>
+
+// FNV-1a
+uint32_t sogv_hash_str(const char* str) {
+    uint32_t hash = 2166136261u;
+    while(*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void sogv_name_map_init(sogv_name_map* map, size_t expected) {
+    size_t cap = 16;
+    while(cap < expected*2) cap *= 2;
+    map->keys = calloc(cap, sizeof(const char*));
+    map->hashes = calloc(cap, sizeof(uint32_t));
+    map->values = calloc(cap, sizeof(int));
+    if(!map->keys || !map->hashes || !map->values) sogv_die("Could not allocate name map");
+    map->cap = cap;
+    map->count = 0;
+}
+
+void sogv_name_map_free(sogv_name_map* map) {
+    free(map->keys);
+    free(map->hashes);
+    free(map->values);
+    map->keys = NULL;
+    map->hashes = NULL;
+    map->values = NULL;
+    map->cap = map->count = 0;
+}
+
+static size_t name_map_slot(const sogv_name_map* map, const char* key, uint32_t hash) {
+    size_t mask = map->cap-1;
+    size_t i = hash & mask;
+    while(map->keys[i] && (map->hashes[i] != hash || strcmp(map->keys[i], key)!=0))
+        i = (i+1) & mask;
+    return i;
+}
+
+static void name_map_grow(sogv_name_map* map) {
+    sogv_name_map bigger;
+    sogv_name_map_init(&bigger, map->cap);
+    for(size_t i=0; i<map->cap; ++i)
+        if(map->keys[i]) {
+            size_t slot = name_map_slot(&bigger, map->keys[i], map->hashes[i]);
+            bigger.keys[slot] = map->keys[i];
+            bigger.hashes[slot] = map->hashes[i];
+            bigger.values[slot] = map->values[i];
+            bigger.count++;
+        }
+    sogv_name_map_free(map);
+    *map = bigger;
+}
+
+bool sogv_name_map_add(sogv_name_map* map, const char* key, int value) {
+    if((map->count+1)*2 > map->cap) name_map_grow(map);
+
+    uint32_t hash = sogv_hash_str(key);
+    size_t slot = name_map_slot(map, key, hash);
+    if(map->keys[slot]) return false;
+
+    map->keys[slot] = key;
+    map->hashes[slot] = hash;
+    map->values[slot] = value;
+    map->count++;
+    return true;
+}
+
+int sogv_name_map_get(const sogv_name_map* map, const char* key) {
+    if(!map->cap) return -1;
+    size_t slot = name_map_slot(map, key, sogv_hash_str(key));
+    return map->keys[slot] ? map->values[slot] : -1;
+}
+
+bool sogv_name_map_remove(sogv_name_map* map, const char* key) {
+    if(!map->cap) return false;
+    size_t mask = map->cap-1;
+    size_t slot = name_map_slot(map, key, sogv_hash_str(key));
+    if(!map->keys[slot]) return false;
+
+    // Backward shift so probe chains stay unbroken without tombstones
+    size_t next = (slot+1) & mask;
+    while(map->keys[next]) {
+        size_t home = map->hashes[next] & mask;
+        if(((next - home) & mask) >= ((next - slot) & mask)) {
+            map->keys[slot] = map->keys[next];
+            map->hashes[slot] = map->hashes[next];
+            map->values[slot] = map->values[next];
+            slot = next;
+        }
+        next = (next+1) & mask;
+    }
+    map->keys[slot] = NULL;
+    map->count--;
+    return true;
+}
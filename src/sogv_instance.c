@@ -0,0 +1,67 @@
+#include <sogv.h>
+
+// Per-instance model and normal matrices for instanced draws. Every sogv VAO points attributes
+// SOGV_ATTR_INSTANCE_MODEL_ID.. at one shared stream buffer with a divisor of 1. GL 3.3 has no
+// base instance, so each instanced draw reads from the start of the buffer: uploads orphan it
+// and write from offset 0, letting the driver hand out fresh storage while earlier draws run.
+
+static struct {
+    GLuint vbo;
+    size_t cap;
+    sogv_instance_data* scratch;
+    size_t scratch_cap;
+} inst;
+
+static void instance_vbo_create() {
+    if(inst.vbo) return;
+    glGenBuffers(1, &inst.vbo);
+    inst.cap = 64;
+    sogv_gl_bind_buffer(GL_ARRAY_BUFFER, inst.vbo);
+    glBufferData(GL_ARRAY_BUFFER, inst.cap*sizeof(sogv_instance_data), NULL, GL_STREAM_DRAW);
+}
+
+void sogv_instance_attach() {
+    instance_vbo_create();
+    sogv_gl_bind_buffer(GL_ARRAY_BUFFER, inst.vbo);
+    for(GLuint c=0; c<4; ++c) {
+        const GLuint model_attr = SOGV_ATTR_INSTANCE_MODEL_ID + c;
+        const GLuint normal_attr = SOGV_ATTR_INSTANCE_NORMAL_ID + c;
+        glEnableVertexAttribArray(model_attr);
+        glVertexAttribPointer(model_attr, 4, GL_FLOAT, GL_FALSE, sizeof(sogv_instance_data),
+                (void*)(offsetof(sogv_instance_data, model) + c*sizeof(vec4)));
+        glVertexAttribDivisor(model_attr, 1);
+        glEnableVertexAttribArray(normal_attr);
+        glVertexAttribPointer(normal_attr, 4, GL_FLOAT, GL_FALSE, sizeof(sogv_instance_data),
+                (void*)(offsetof(sogv_instance_data, normal) + c*sizeof(vec4)));
+        glVertexAttribDivisor(normal_attr, 1);
+    }
+}
+
+sogv_instance_data* sogv_instance_scratch(size_t count) {
+    if(count > inst.scratch_cap) {
+        inst.scratch_cap = count;
+        sogv_arr_resize(sogv_instance_data, inst.scratch, inst.scratch_cap*sizeof(sogv_instance_data));
+    }
+    return inst.scratch;
+}
+
+void sogv_instance_fill(sogv_instance_data* data, mat4x4 transform) {
+    mat4x4_dup(data->model, transform);
+    mat4x4_invert(data->normal, transform);
+    mat4x4_transpose(data->normal, data->normal);
+}
+
+void sogv_instance_upload(const sogv_instance_data* data, size_t count) {
+    instance_vbo_create();
+    sogv_gl_bind_buffer(GL_ARRAY_BUFFER, inst.vbo);
+    // growing keeps the buffer name, so VAOs pointing at it stay valid
+    while(inst.cap < count) inst.cap *= 2;
+    glBufferData(GL_ARRAY_BUFFER, inst.cap*sizeof(sogv_instance_data), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count*sizeof(sogv_instance_data), data);
+}
+
+void sogv_instance_free() {
+    if(inst.vbo) sogv_gl_delete_buffers(1, &inst.vbo);
+    free(inst.scratch);
+    memset(&inst, 0, sizeof(inst));
+}
@@ -0,0 +1,206 @@
+#include <sogv.h>
+
+typedef struct sogv_job {
+    sogv_job_fn work;
+    sogv_job_fn done;
+    void* arg;
+    sogv_job_group* group;
+    struct sogv_job* next;
+} sogv_job;
+
+typedef struct sogv_job_queue {
+    sogv_job* head;
+    sogv_job* tail;
+} sogv_job_queue;
+
+static struct {
+    SDL_Thread** threads;
+    size_t thread_count;
+    SDL_mutex* lock;
+    SDL_cond* wake;
+    SDL_cond* finished_any;
+    sogv_job_queue pending;
+    sogv_job_queue finished;
+    bool quitting;
+} jobs;
+
+static void job_queue_push(sogv_job_queue* queue, sogv_job* job) {
+    job->next = NULL;
+    if(queue->tail) queue->tail->next = job;
+    else queue->head = job;
+    queue->tail = job;
+}
+
+static sogv_job* job_queue_pop(sogv_job_queue* queue) {
+    sogv_job* job = queue->head;
+    if(job) {
+        queue->head = job->next;
+        if(!queue->head) queue->tail = NULL;
+    }
+    return job;
+}
+
+// First job of the group, unlinked from wherever it sits in the queue
+static sogv_job* job_queue_take(sogv_job_queue* queue, const sogv_job_group* group) {
+    sogv_job* prev = NULL;
+    for(sogv_job* job = queue->head; job; prev = job, job = job->next) {
+        if(job->group != group) continue;
+        if(prev) prev->next = job->next;
+        else queue->head = job->next;
+        if(queue->tail == job) queue->tail = prev;
+        return job;
+    }
+    return NULL;
+}
+
+// Called with the lock held
+static void job_finish(sogv_job* job) {
+    if(job->group && --job->group->pending == 0)
+        SDL_CondBroadcast(jobs.finished_any);
+    if(job->done) job_queue_push(&jobs.finished, job);
+    else free(job);
+}
+
+static int job_worker(void* data) {
+    (void)data;
+    SDL_LockMutex(jobs.lock);
+    while(true) {
+        sogv_job* job;
+        while(!(job = job_queue_pop(&jobs.pending)) && !jobs.quitting)
+            SDL_CondWait(jobs.wake, jobs.lock);
+        if(!job) break;
+        SDL_UnlockMutex(jobs.lock);
+
+        if(job->work) job->work(job->arg);
+
+        SDL_LockMutex(jobs.lock);
+        job_finish(job);
+    }
+    SDL_UnlockMutex(jobs.lock);
+    return 0;
+}
+
+void sogv_jobs_init(size_t thread_count) {
+    if(jobs.threads || jobs.quitting) return;
+    if(thread_count == 0) {
+        int cpus = SDL_GetCPUCount();
+        thread_count = cpus > 2 ? cpus-1 : 1;
+    }
+
+    jobs.lock = SDL_CreateMutex();
+    jobs.wake = SDL_CreateCond();
+    jobs.finished_any = SDL_CreateCond();
+    if(!jobs.lock || !jobs.wake || !jobs.finished_any) sogv_die_v("Could not create job queue: %s", SDL_GetError());
+    jobs.quitting = false;
+    jobs.thread_count = thread_count;
+    jobs.threads = calloc(thread_count, sizeof(SDL_Thread*));
+    for(size_t i=0; i<thread_count; ++i)
+        if(!(jobs.threads[i] = SDL_CreateThread(job_worker, "sogv_worker", NULL)))
+            sogv_die_v("Could not create worker thread: %s", SDL_GetError());
+    sogv_log_v("Started %zu worker threads", thread_count);
+}
+
+void sogv_jobs_quit() {
+    if(!jobs.threads) return;
+    SDL_LockMutex(jobs.lock);
+    jobs.quitting = true;
+    SDL_CondBroadcast(jobs.wake);
+    SDL_UnlockMutex(jobs.lock);
+
+    for(size_t i=0; i<jobs.thread_count; ++i)
+        SDL_WaitThread(jobs.threads[i], NULL);
+    free(jobs.threads);
+    jobs.threads = NULL;
+
+    // Anything left over still gets its main thread callback so nothing leaks. Leftovers may
+    // push more jobs (an import queueing its texture decodes); quitting stays set so those
+    // land in the queue and are drained here or by sogv_jobs_wait instead of restarting
+    // the pool.
+    SDL_LockMutex(jobs.lock);
+    while(jobs.pending.head || jobs.finished.head) {
+        sogv_job* job;
+        while((job = job_queue_pop(&jobs.pending))) {
+            SDL_UnlockMutex(jobs.lock);
+            if(job->work) job->work(job->arg);
+            SDL_LockMutex(jobs.lock);
+            job_finish(job);
+        }
+        SDL_UnlockMutex(jobs.lock);
+        sogv_jobs_poll();
+        SDL_LockMutex(jobs.lock);
+    }
+    SDL_UnlockMutex(jobs.lock);
+
+    SDL_DestroyCond(jobs.wake);
+    SDL_DestroyCond(jobs.finished_any);
+    SDL_DestroyMutex(jobs.lock);
+    jobs.wake = NULL;
+    jobs.finished_any = NULL;
+    jobs.lock = NULL;
+    jobs.quitting = false;
+}
+
+static void job_push(sogv_job_fn work, sogv_job_fn done, void* arg, sogv_job_group* group) {
+    if(!jobs.threads && !jobs.quitting) sogv_jobs_init(0);
+
+    sogv_job* job = malloc(sizeof(sogv_job));
+    if(!job) sogv_die("Could not allocate job");
+    job->work = work;
+    job->done = done;
+    job->arg = arg;
+    job->group = group;
+
+    SDL_LockMutex(jobs.lock);
+    if(group) group->pending++;
+    job_queue_push(&jobs.pending, job);
+    SDL_CondSignal(jobs.wake);
+    SDL_CondBroadcast(jobs.finished_any);
+    SDL_UnlockMutex(jobs.lock);
+}
+
+void sogv_job_push(sogv_job_fn work, sogv_job_fn done, void* arg) {
+    job_push(work, done, arg, NULL);
+}
+
+void sogv_job_push_group(sogv_job_group* group, sogv_job_fn work, void* arg) {
+    job_push(work, NULL, arg, group);
+}
+
+// The waiting thread runs the group's queued jobs itself, so waiting from inside a job
+// (an async import waiting on its texture decodes) cannot starve the pool. Jobs of other
+// groups are left to the workers: a frame waiting on its rasterizer bands must not end up
+// running someone's model import.
+void sogv_jobs_wait(sogv_job_group* group) {
+    if(!jobs.lock) return;
+    SDL_LockMutex(jobs.lock);
+    while(group->pending) {
+        sogv_job* job = job_queue_take(&jobs.pending, group);
+        if(!job) {
+            SDL_CondWait(jobs.finished_any, jobs.lock);
+            continue;
+        }
+        SDL_UnlockMutex(jobs.lock);
+        if(job->work) job->work(job->arg);
+        SDL_LockMutex(jobs.lock);
+        job_finish(job);
+    }
+    SDL_UnlockMutex(jobs.lock);
+}
+
+size_t sogv_jobs_poll() {
+    if(!jobs.lock) return 0;
+
+    SDL_LockMutex(jobs.lock);
+    sogv_job_queue finished = jobs.finished;
+    jobs.finished.head = jobs.finished.tail = NULL;
+    SDL_UnlockMutex(jobs.lock);
+
+    size_t count = 0;
+    sogv_job* job;
+    while((job = job_queue_pop(&finished))) {
+        job->done(job->arg);
+        free(job);
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,261 @@
+#include <sogv.h>
+#include <limits.h>
+
+// GPU-ready texture containers: KTX 1.1 and DDS (legacy FourCC or DX10 header) holding
+// S3TC/RGTC/BPTC block-compressed 2D textures. Levels are kept back to back in img->data,
+// largest first, and go to GL with glCompressedTexImage2D as they are.
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+    #define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+    #define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+    #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+    #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+    #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+    #define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+    #define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+    #define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+    #define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#endif
+
+static const unsigned char ktx_magic[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+#define DDS_HEADER_SIZE 128
+#define DDS_DX10_SIZE 20
+#define DDPF_ALPHAPIXELS 0x1
+#define DDPF_FOURCC 0x4
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_VOLUME 0x200000
+#define DDS_FOURCC(A, B, C, D) ((uint32_t)(A) | (uint32_t)(B)<<8 | (uint32_t)(C)<<16 | (uint32_t)(D)<<24)
+
+// S3TC and BPTC are extensions on GL 3.3, RGTC is core. Decodes run on workers without a
+// context, so the GL thread looks the extensions up once.
+static struct {
+    bool s3tc;
+    bool s3tc_srgb;
+    bool bptc;
+    SDL_atomic_t probed;
+} ktx_formats;
+
+void sogv_image_compressed_probe() {
+    ktx_formats.s3tc = SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc");
+    ktx_formats.s3tc_srgb = ktx_formats.s3tc && (SDL_GL_ExtensionSupported("GL_EXT_texture_sRGB")
+            || SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc_srgb"));
+    ktx_formats.bptc = SDL_GL_ExtensionSupported("GL_ARB_texture_compression_bptc");
+    SDL_AtomicSet(&ktx_formats.probed, 1);
+}
+
+static bool ktx_format_supported(GLenum format) {
+    if(!SDL_AtomicGet(&ktx_formats.probed) && SDL_GL_GetCurrentContext()) sogv_image_compressed_probe();
+    switch(format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return ktx_formats.s3tc;
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+            return ktx_formats.s3tc_srgb;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+        case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+            return ktx_formats.bptc;
+        default:
+            return true;
+    }
+}
+
+// DDS is little-endian; KTX tags its byte order in the header
+static uint32_t ktx_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1]<<8 | (uint32_t)p[2]<<16 | (uint32_t)p[3]<<24;
+}
+
+static uint32_t ktx_u32_swapped(const unsigned char* p) {
+    return (uint32_t)p[3] | (uint32_t)p[2]<<8 | (uint32_t)p[1]<<16 | (uint32_t)p[0]<<24;
+}
+
+// Bytes per 4x4 block, 0 for formats sogv does not handle
+static size_t ktx_block_bytes(GLenum format) {
+    switch(format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_SIGNED_RED_RGTC1:
+            return 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+        case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t sogv_image_level_size(const sogv_image* img, int level) {
+    if(level < 0 || level > 30) return 0;
+    size_t w = img->w >> level, h = img->h >> level;
+    if(w < 1) w = 1;
+    if(h < 1) h = 1;
+    return ((w+3)/4) * ((h+3)/4) * ktx_block_bytes(img->format);
+}
+
+static GLenum dds_dxgi_format(uint32_t dxgi) {
+    switch(dxgi) {
+        case 71: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case 72: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+        case 74: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        case 75: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+        case 77: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case 78: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+        case 80: return GL_COMPRESSED_RED_RGTC1;
+        case 81: return GL_COMPRESSED_SIGNED_RED_RGTC1;
+        case 83: return GL_COMPRESSED_RG_RGTC2;
+        case 84: return GL_COMPRESSED_SIGNED_RG_RGTC2;
+        case 95: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+        case 96: return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+        case 98: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        case 99: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+        default: return 0;
+    }
+}
+
+static GLenum dds_fourcc_format(uint32_t fourcc, uint32_t pf_flags) {
+    switch(fourcc) {
+        case DDS_FOURCC('D','X','T','1'):
+            return pf_flags & DDPF_ALPHAPIXELS ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case DDS_FOURCC('D','X','T','3'): return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        case DDS_FOURCC('D','X','T','5'): return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case DDS_FOURCC('A','T','I','1'):
+        case DDS_FOURCC('B','C','4','U'): return GL_COMPRESSED_RED_RGTC1;
+        case DDS_FOURCC('B','C','4','S'): return GL_COMPRESSED_SIGNED_RED_RGTC1;
+        case DDS_FOURCC('A','T','I','2'):
+        case DDS_FOURCC('B','C','5','U'): return GL_COMPRESSED_RG_RGTC2;
+        case DDS_FOURCC('B','C','5','S'): return GL_COMPRESSED_SIGNED_RG_RGTC2;
+        default: return 0;
+    }
+}
+
+// Rejects empty or negative sizes and clamps the level count to a full mip chain, so no level
+// math runs on what the file claims
+static bool ktx_dims_set(sogv_image* img, uint32_t w, uint32_t h, uint32_t levels) {
+    if(w < 1 || h < 1 || w > INT_MAX || h > INT_MAX) return false;
+    uint32_t max_levels = 1;
+    for(uint32_t s = w > h ? w : h; s > 1; s >>= 1) max_levels++;
+    img->w = w;
+    img->h = h;
+    img->levels = levels < 1 ? 1 : levels > max_levels ? max_levels : levels;
+    return true;
+}
+
+// Fills in the header fields and returns the offset of level 0, or 0 if unusable
+static size_t dds_parse(sogv_image* img, const unsigned char* file, size_t size) {
+    if(size < DDS_HEADER_SIZE || memcmp(file, "DDS ", 4)!=0 || ktx_u32(file+4) != 124) return 0;
+    if(ktx_u32(file+112) & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) return 0;
+
+    if(!ktx_dims_set(img, ktx_u32(file+16), ktx_u32(file+12), ktx_u32(file+28))) return 0;
+    uint32_t pf_flags = ktx_u32(file+80);
+    uint32_t fourcc = ktx_u32(file+84);
+    if(!(pf_flags & DDPF_FOURCC)) return 0;
+
+    if(fourcc == DDS_FOURCC('D','X','1','0')) {
+        if(size < DDS_HEADER_SIZE + DDS_DX10_SIZE) return 0;
+        // resource dimension 3 is TEXTURE2D; arrays are not handled
+        if(ktx_u32(file+DDS_HEADER_SIZE+4) != 3 || ktx_u32(file+DDS_HEADER_SIZE+12) > 1) return 0;
+        img->format = dds_dxgi_format(ktx_u32(file+DDS_HEADER_SIZE));
+        return img->format ? DDS_HEADER_SIZE + DDS_DX10_SIZE : 0;
+    }
+    img->format = dds_fourcc_format(fourcc, pf_flags);
+    return img->format ? DDS_HEADER_SIZE : 0;
+}
+
+// KTX levels each carry a 4 byte imageSize prefix; they are packed together in place
+static size_t ktx_parse(sogv_image* img, unsigned char* file, size_t size) {
+    if(size < 64 || memcmp(file, ktx_magic, 12)!=0) return 0;
+    uint32_t (*rd)(const unsigned char*) = ktx_u32(file+12) == 0x04030201 ? ktx_u32 : ktx_u32_swapped;
+    if(rd(file+12) != 0x04030201) return 0;
+
+    // glType 0 means compressed; depth, array elements and faces must describe a plain 2D texture
+    if(rd(file+16) != 0 || rd(file+44) != 0 || rd(file+48) != 0 || rd(file+52) != 1) return 0;
+    img->format = rd(file+28);
+    if(!ktx_block_bytes(img->format)) return 0;
+    if(!ktx_dims_set(img, rd(file+36), rd(file+40) ? rd(file+40) : 1, rd(file+56))) return 0;
+
+    size_t src = 64 + (size_t)rd(file+60);
+    size_t dst = src;
+    for(int l=0; l<img->levels; ++l) {
+        size_t len = sogv_image_level_size(img, l);
+        if(src > size || size - src < 4 || rd(file+src) != len || size - src - 4 < len) return 0;
+        memmove(file+dst, file+src+4, len);
+        src += 4 + ((len+3) & ~(size_t)3);
+        dst += len;
+    }
+    return 64 + (size_t)rd(file+60);
+}
+
+bool sogv_image_is_compressed(const char* path) {
+    const char* ext = strrchr(path, '.');
+    return ext && (SDL_strcasecmp(ext, ".ktx") == 0 || SDL_strcasecmp(ext, ".dds") == 0);
+}
+
+bool sogv_image_load_compressed(sogv_image* img, const char* path) {
+    img->data = NULL;
+    img->n = 0;
+    img->format = 0;
+    img->levels = 0;
+
+    FILE* file = fopen(path, "rb");
+    if(!file) return false;
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    unsigned char* blob = NULL;
+    if(size > 0 && (blob = malloc(size)))
+        if(fread(blob, size, 1, file) != 1) free(blob), blob = NULL;
+    fclose(file);
+    if(!blob) {
+        sogv_log_v("Could not read texture %s", path);
+        return false;
+    }
+
+    size_t off = size >= 4 && memcmp(blob, "DDS ", 4)==0 ? dds_parse(img, blob, size) : ktx_parse(img, blob, size);
+    size_t total = 0;
+    if(off) for(int l=0; l<img->levels; ++l) total += sogv_image_level_size(img, l);
+    if(!off || !total || total > (size_t)size - off) {
+        sogv_log_v("Texture %s is not a supported compressed 2D texture", path);
+        free(blob);
+        img->format = 0;
+        return false;
+    }
+    if(!ktx_format_supported(img->format)) {
+        sogv_log_v("Texture %s needs a compression extension this driver lacks (format 0x%x)", path, img->format);
+        free(blob);
+        img->format = 0;
+        return false;
+    }
+
+    memmove(blob, blob+off, total);
+    img->data = blob;
+    sogv_log_v("Loaded %s: %dx%d, %d levels", path, img->w, img->h, img->levels);
+    return true;
+}
@@ -0,0 +1,484 @@
+#include <sogv.h>
+
+// Mesh LODs by quadric error simplification (Garland & Heckbert) restricted to half-edge
+// collapses: a vertex merges into a neighbour and never moves, so every level indexes the
+// mesh's own vertices and the levels share its VBO. Vertices are welded by position to see the
+// real topology. A position with several vertices (a UV or normal seam) only collapses along
+// the seam, each of its vertices onto the one across the edge, and vertices on open edges only
+// move along them; border and seam edges also add planes that hold their outline. Skinning
+// stays valid as vertices keep their own weights, and a vertex only merges into one that its
+// dominant bone also moves, so limbs do not get glued to the body.
+//
+// Collapses run in passes: every edge is costed both ways, sorted, and taken greedily while no
+// earlier collapse of the pass touched the triangles around it.
+
+#define LOD_MIN_TRIS 32
+// a level has to drop this share of the previous one's triangles to be worth keeping
+#define LOD_MIN_REDUCTION 0.15f
+// largest error, in mesh radii; coarser levels would look like blobs at any distance
+#define LOD_MAX_ERROR 0.25f
+// border and seam planes outweigh faces, so outlines give way last
+#define LOD_EDGE_WEIGHT 10.0
+// triangles turning more than ~75 degrees block a collapse
+#define LOD_FLIP_COS 0.25f
+
+typedef struct lod_quadric {
+    // upper triangle of the symmetric 4x4: xx xy xz xw yy yz yw zz zw ww
+    double a[10];
+    double w;
+} lod_quadric;
+
+typedef struct lod_collapse {
+    uint src, dst;
+    float cost;
+} lod_collapse;
+
+typedef struct lod_ctx {
+    const sogv_vert* verts;
+    size_t vert_count;
+    // position group of each vertex and the next vertex of the same group, circular
+    uint* group;
+    uint* wedge_next;
+    size_t group_count;
+    lod_quadric* quadrics;
+    int* bone;
+    uint* remap;
+    double max_cost;
+    // per pass: triangles around each group, open half-edges, locks
+    uint* tri_offsets;
+    uint* tri_fill;
+    uint* tris;
+    bool* half_open;
+    bool* group_open;
+    bool* locked;
+    lod_collapse* collapses;
+    uint* map;
+} lod_ctx;
+
+size_t sogv_mesh_index_total(const sogv_mesh* mesh) {
+    if(!mesh->lod_count) return mesh->indice_count;
+    const sogv_mesh_lod* last = &mesh->lods[mesh->lod_count-1];
+    return last->first_index + last->indice_count;
+}
+
+sogv_mesh_lod sogv_mesh_lod_get(const sogv_mesh* mesh, size_t level) {
+    if(!mesh->lod_count) return (sogv_mesh_lod){ .first_index = 0, .indice_count = mesh->indice_count };
+    return mesh->lods[level < mesh->lod_count ? level : mesh->lod_count-1];
+}
+
+static void lod_quadric_plane(lod_quadric* q, const double* n, double d, double weight) {
+    const double p[4] = {n[0], n[1], n[2], d};
+    size_t k = 0;
+    for(size_t i=0; i<4; ++i)
+        for(size_t j=i; j<4; ++j)
+            q->a[k++] += weight*p[i]*p[j];
+    q->w += weight;
+}
+
+static double lod_quadric_eval(const lod_quadric* q, const float* pos) {
+    const double x = pos[0], y = pos[1], z = pos[2];
+    const double* a = q->a;
+    double e = a[0]*x*x + 2.0*a[1]*x*y + 2.0*a[2]*x*z + 2.0*a[3]*x
+             + a[4]*y*y + 2.0*a[5]*y*z + 2.0*a[6]*y
+             + a[7]*z*z + 2.0*a[8]*z + a[9];
+    return e > 0.0 ? e : 0.0;
+}
+
+static uint32_t lod_pos_hash(const float* pos) {
+    uint32_t h = 0;
+    for(size_t k=0; k<3; ++k) {
+        // +0.0f folds -0.0f into 0.0f, which compare equal
+        float f = pos[k] + 0.0f;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        h = (h ^ bits) * 0x9e3779b1u;
+        h ^= h >> 15;
+    }
+    return h;
+}
+
+static void lod_weld(lod_ctx* ctx) {
+    size_t cap = 16;
+    while(cap < ctx->vert_count*2) cap *= 2;
+    uint* slots = malloc(cap*sizeof(uint));
+    if(!slots) sogv_die("Could not allocate LOD weld table");
+    memset(slots, 0xff, cap*sizeof(uint));
+
+    for(uint v=0; v<ctx->vert_count; ++v) {
+        const float* pos = ctx->verts[v].pos;
+        size_t s = lod_pos_hash(pos) & (cap-1);
+        while(slots[s] != UINT32_MAX) {
+            const float* other = ctx->verts[slots[s]].pos;
+            if(other[0] == pos[0] && other[1] == pos[1] && other[2] == pos[2]) break;
+            s = (s+1) & (cap-1);
+        }
+        if(slots[s] == UINT32_MAX) {
+            slots[s] = v;
+            ctx->group[v] = ctx->group_count++;
+            ctx->wedge_next[v] = v;
+        } else {
+            uint first = slots[s];
+            ctx->group[v] = ctx->group[first];
+            ctx->wedge_next[v] = ctx->wedge_next[first];
+            ctx->wedge_next[first] = v;
+        }
+    }
+    free(slots);
+}
+
+// Triangles around every group, and which half-edges have no twin (borders and seams)
+static void lod_topology(lod_ctx* ctx, const uint* indices, size_t tri_count) {
+    memset(ctx->tri_offsets, 0, (ctx->group_count+1)*sizeof(uint));
+    memset(ctx->tri_fill, 0, ctx->group_count*sizeof(uint));
+    for(size_t i=0; i<tri_count*3; ++i) ctx->tri_offsets[ctx->group[indices[i]]+1]++;
+    for(size_t g=0; g<ctx->group_count; ++g) ctx->tri_offsets[g+1] += ctx->tri_offsets[g];
+    for(size_t i=0; i<tri_count*3; ++i) {
+        uint g = ctx->group[indices[i]];
+        ctx->tris[ctx->tri_offsets[g] + ctx->tri_fill[g]++] = i/3;
+    }
+
+    memset(ctx->group_open, 0, ctx->group_count*sizeof(bool));
+    for(size_t t=0; t<tri_count; ++t)
+        for(size_t k=0; k<3; ++k) {
+            uint u = indices[t*3+k], v = indices[t*3+(k+1)%3];
+            uint g = ctx->group[v];
+            bool twin = false;
+            for(uint i=ctx->tri_offsets[g]; i<ctx->tri_offsets[g+1] && !twin; ++i) {
+                const uint* tri = &indices[ctx->tris[i]*3];
+                for(size_t j=0; j<3 && !twin; ++j)
+                    twin = tri[j] == v && tri[(j+1)%3] == u;
+            }
+            ctx->half_open[t*3+k] = !twin;
+            if(!twin) ctx->group_open[ctx->group[u]] = ctx->group_open[g] = true;
+        }
+}
+
+// Face planes weighted by area, plus a plane through every open edge standing on its face
+static void lod_quadrics(lod_ctx* ctx, const uint* indices, size_t tri_count) {
+    for(size_t t=0; t<tri_count; ++t) {
+        const float* p[3];
+        for(size_t k=0; k<3; ++k) p[k] = ctx->verts[indices[t*3+k]].pos;
+        double e1[3], e2[3], n[3];
+        for(size_t c=0; c<3; ++c) {
+            e1[c] = p[1][c] - p[0][c];
+            e2[c] = p[2][c] - p[0][c];
+        }
+        n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+        n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+        n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+        double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(len <= 0.0) continue;
+        for(size_t c=0; c<3; ++c) n[c] /= len;
+        double d = -(n[0]*p[0][0] + n[1]*p[0][1] + n[2]*p[0][2]);
+        for(size_t k=0; k<3; ++k)
+            lod_quadric_plane(&ctx->quadrics[ctx->group[indices[t*3+k]]], n, d, len*0.5);
+
+        for(size_t k=0; k<3; ++k) {
+            if(!ctx->half_open[t*3+k]) continue;
+            const float* a = p[k];
+            const float* b = p[(k+1)%3];
+            double e[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]}, m[3];
+            m[0] = e[1]*n[2] - e[2]*n[1];
+            m[1] = e[2]*n[0] - e[0]*n[2];
+            m[2] = e[0]*n[1] - e[1]*n[0];
+            double m_len = sqrt(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+            if(m_len <= 0.0) continue;
+            for(size_t c=0; c<3; ++c) m[c] /= m_len;
+            double md = -(m[0]*a[0] + m[1]*a[1] + m[2]*a[2]);
+            double weight = (e[0]*e[0] + e[1]*e[1] + e[2]*e[2]) * LOD_EDGE_WEIGHT;
+            lod_quadric_plane(&ctx->quadrics[ctx->group[indices[t*3+k]]], m, md, weight);
+            lod_quadric_plane(&ctx->quadrics[ctx->group[indices[t*3+(k+1)%3]]], m, md, weight);
+        }
+    }
+}
+
+static bool lod_skin_ok(const lod_ctx* ctx, uint src, uint dst) {
+    if(ctx->bone[src] < 0) return true;
+    const sogv_vert* v = &ctx->verts[dst];
+    for(size_t k=0; k<MAX_BONE_INFLUENCE; ++k)
+        if(v->weights[k] > 0.0f && (int)v->bone_info[k] == ctx->bone[src]) return true;
+    return false;
+}
+
+static float lod_cost(const lod_ctx* ctx, uint src, uint dst) {
+    const lod_quadric* qa = &ctx->quadrics[ctx->group[src]];
+    const lod_quadric* qb = &ctx->quadrics[ctx->group[dst]];
+    const float* pos = ctx->verts[dst].pos;
+    double w = qa->w + qb->w;
+    return w > 0.0 ? (lod_quadric_eval(qa, pos) + lod_quadric_eval(qb, pos)) / w : 0.0;
+}
+
+static int lod_collapse_cmp(const void* a, const void* b) {
+    float ca = ((const lod_collapse*)a)->cost, cb = ((const lod_collapse*)b)->cost;
+    return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+// Pairs each vertex at the source position with the one it shares an edge with at the
+// target; fails if one has none (moving it would tear a seam) or several
+static bool lod_collapse_map(lod_ctx* ctx, const uint* indices, uint src, uint dst, size_t* map_count) {
+    const uint ga = ctx->group[src], gb = ctx->group[dst];
+    size_t n = 0;
+    uint w = src;
+    do {
+        uint found = UINT32_MAX;
+        bool used = false;
+        for(uint i=ctx->tri_offsets[ga]; i<ctx->tri_offsets[ga+1]; ++i) {
+            const uint* tri = &indices[ctx->tris[i]*3];
+            for(size_t k=0; k<3; ++k) {
+                if(tri[k] != w) continue;
+                used = true;
+                for(size_t j=1; j<3; ++j) {
+                    uint c = tri[(k+j)%3];
+                    if(ctx->group[c] != gb) continue;
+                    if(found != UINT32_MAX && found != c) return false;
+                    found = c;
+                }
+            }
+        }
+        if(used && found == UINT32_MAX) return false;
+        ctx->map[n*2] = w;
+        ctx->map[n*2+1] = used ? found : dst;
+        n++;
+        w = ctx->wedge_next[w];
+    } while(w != src);
+    *map_count = n;
+    return true;
+}
+
+// Triangles around the source that survive must not fold over; returns the ones that vanish
+static bool lod_collapse_flips(const lod_ctx* ctx, const uint* indices, uint src, uint dst, size_t* removed) {
+    const uint ga = ctx->group[src], gb = ctx->group[dst];
+    const float* target = ctx->verts[dst].pos;
+    size_t gone = 0;
+    for(uint i=ctx->tri_offsets[ga]; i<ctx->tri_offsets[ga+1]; ++i) {
+        const uint* tri = &indices[ctx->tris[i]*3];
+        const float* p[3];
+        const float* q[3];
+        bool degenerate = false;
+        for(size_t k=0; k<3; ++k) {
+            p[k] = ctx->verts[tri[k]].pos;
+            q[k] = ctx->group[tri[k]] == ga ? target : p[k];
+            degenerate |= ctx->group[tri[k]] == gb;
+        }
+        if(degenerate) {
+            gone++;
+            continue;
+        }
+        vec3 e1, e2, n_old, n_new;
+        vec3_sub(e1, p[1], p[0]);
+        vec3_sub(e2, p[2], p[0]);
+        vec3_mul_cross(n_old, e1, e2);
+        vec3_sub(e1, q[1], q[0]);
+        vec3_sub(e2, q[2], q[0]);
+        vec3_mul_cross(n_new, e1, e2);
+        // slivers count as folded too; already degenerate triangles are left alone
+        const float old_len = vec3_len(n_old);
+        if(old_len > 0.0f && vec3_mul_inner(n_old, n_new) <= LOD_FLIP_COS * old_len * vec3_len(n_new))
+            return false;
+    }
+    *removed = gone;
+    return true;
+}
+
+// One round of independent collapses; returns the new triangle count
+static size_t lod_pass(lod_ctx* ctx, uint* indices, size_t tri_count, size_t target_tris, double max_cost) {
+    lod_topology(ctx, indices, tri_count);
+
+    size_t count = 0;
+    for(size_t t=0; t<tri_count; ++t)
+        for(size_t k=0; k<3; ++k) {
+            uint u = indices[t*3+k], v = indices[t*3+(k+1)%3];
+            if(ctx->group[u] == ctx->group[v]) continue;
+            const bool open = ctx->half_open[t*3+k];
+            // a closed edge shows up from both of its triangles; take it once
+            if(!open && u > v) continue;
+            for(size_t dir=0; dir<2; ++dir) {
+                uint src = dir ? v : u, dst = dir ? u : v;
+                if(ctx->group_open[ctx->group[src]] && !open) continue;
+                if(!lod_skin_ok(ctx, src, dst)) continue;
+                float cost = lod_cost(ctx, src, dst);
+                if(cost > max_cost) continue;
+                ctx->collapses[count++] = (lod_collapse){ .src = src, .dst = dst, .cost = cost };
+            }
+        }
+    qsort(ctx->collapses, count, sizeof(lod_collapse), lod_collapse_cmp);
+
+    memset(ctx->locked, 0, ctx->group_count*sizeof(bool));
+    size_t removed = 0, applied = 0;
+    for(size_t c=0; c<count && tri_count - removed > target_tris; ++c) {
+        const lod_collapse* col = &ctx->collapses[c];
+        const uint ga = ctx->group[col->src], gb = ctx->group[col->dst];
+        size_t map_count, gone;
+        if(ctx->locked[ga] || ctx->locked[gb]) continue;
+        if(!lod_collapse_flips(ctx, indices, col->src, col->dst, &gone)) continue;
+        if(!lod_collapse_map(ctx, indices, col->src, col->dst, &map_count)) continue;
+
+        for(size_t m=0; m<map_count; ++m) ctx->remap[ctx->map[m*2]] = ctx->map[m*2+1];
+        lod_quadric* qa = &ctx->quadrics[ga];
+        lod_quadric* qb = &ctx->quadrics[gb];
+        for(size_t k=0; k<10; ++k) qb->a[k] += qa->a[k];
+        qb->w += qa->w;
+        if(col->cost > ctx->max_cost) ctx->max_cost = col->cost;
+
+        // the source's one-ring is settled for this pass
+        ctx->locked[ga] = ctx->locked[gb] = true;
+        for(uint i=ctx->tri_offsets[ga]; i<ctx->tri_offsets[ga+1]; ++i)
+            for(size_t k=0; k<3; ++k) ctx->locked[ctx->group[indices[ctx->tris[i]*3+k]]] = true;
+        removed += gone;
+        applied++;
+    }
+    if(!applied) return tri_count;
+
+    size_t out = 0;
+    for(size_t t=0; t<tri_count; ++t) {
+        uint a = ctx->remap[indices[t*3]], b = ctx->remap[indices[t*3+1]], c = ctx->remap[indices[t*3+2]];
+        uint ga = ctx->group[a], gb = ctx->group[b], gc = ctx->group[c];
+        if(ga == gb || gb == gc || ga == gc) continue;
+        indices[out*3] = a;
+        indices[out*3+1] = b;
+        indices[out*3+2] = c;
+        out++;
+    }
+    return out;
+}
+
+void sogv_mesh_lods(sogv_mesh* mesh) {
+    mesh->lod_count = 0;
+    if(mesh->indice_count % 3 != 0) {
+        sogv_log("Mesh is not all triangles, skipping LODs");
+        return;
+    }
+    const size_t base_tris = mesh->indice_count / 3;
+    mesh->lods[0] = (sogv_mesh_lod){ .first_index = 0, .indice_count = mesh->indice_count };
+    mesh->lod_count = 1;
+    if(base_tris < LOD_MIN_TRIS*2) return;
+
+    lod_ctx ctx = {
+        .verts = mesh->verts,
+        .vert_count = mesh->vert_count,
+        .group = malloc(mesh->vert_count*sizeof(uint)),
+        .wedge_next = malloc(mesh->vert_count*sizeof(uint)),
+        .bone = malloc(mesh->vert_count*sizeof(int)),
+        .remap = malloc(mesh->vert_count*sizeof(uint)),
+        .map = malloc(mesh->vert_count*2*sizeof(uint)),
+        .tris = malloc(mesh->indice_count*sizeof(uint)),
+        .half_open = malloc(mesh->indice_count*sizeof(bool)),
+        .collapses = malloc(mesh->indice_count*2*sizeof(lod_collapse)),
+    };
+    uint* work = malloc(mesh->indice_count*sizeof(uint));
+    if(!ctx.group || !ctx.wedge_next || !ctx.bone || !ctx.remap || !ctx.map || !ctx.tris
+            || !ctx.half_open || !ctx.collapses || !work)
+        sogv_die("Could not allocate LOD builder");
+
+    lod_weld(&ctx);
+    ctx.quadrics = calloc(ctx.group_count, sizeof(lod_quadric));
+    ctx.tri_offsets = malloc((ctx.group_count+1)*sizeof(uint));
+    ctx.tri_fill = malloc(ctx.group_count*sizeof(uint));
+    ctx.group_open = malloc(ctx.group_count*sizeof(bool));
+    ctx.locked = malloc(ctx.group_count*sizeof(bool));
+    if(!ctx.quadrics || !ctx.tri_offsets || !ctx.tri_fill || !ctx.group_open || !ctx.locked)
+        sogv_die("Could not allocate LOD builder");
+
+    vec3 lo = {INFINITY, INFINITY, INFINITY}, hi = {-INFINITY, -INFINITY, -INFINITY};
+    for(uint v=0; v<mesh->vert_count; ++v) {
+        const sogv_vert* vert = &mesh->verts[v];
+        vec3_min(lo, lo, vert->pos);
+        vec3_max(hi, hi, vert->pos);
+        ctx.remap[v] = v;
+        ctx.bone[v] = -1;
+        float heaviest = 0.0f;
+        for(size_t k=0; k<MAX_BONE_INFLUENCE; ++k)
+            if(vert->weights[k] > heaviest) {
+                heaviest = vert->weights[k];
+                ctx.bone[v] = (int)vert->bone_info[k];
+            }
+    }
+    vec3 diag;
+    vec3_sub(diag, hi, lo);
+    const double max_error = LOD_MAX_ERROR * 0.5 * vec3_len(diag);
+
+    memcpy(work, mesh->indices, mesh->indice_count*sizeof(uint));
+    lod_topology(&ctx, work, base_tris);
+    lod_quadrics(&ctx, work, base_tris);
+
+    // each level aims at half of the one before and starts from it
+    size_t tris = base_tris;
+    uint* out = mesh->indices;
+    size_t total = mesh->indice_count;
+    while(mesh->lod_count < SOGV_LOD_MAX && tris >= LOD_MIN_TRIS*2) {
+        const size_t prev = tris, target = tris/2;
+        while(tris > target) {
+            size_t next = lod_pass(&ctx, work, tris, target, max_error*max_error);
+            if(next == tris) break;
+            tris = next;
+        }
+        if(tris > prev - prev*LOD_MIN_REDUCTION) break;
+
+        sogv_arr_resize(uint, out, (total + tris*3)*sizeof(uint));
+        memcpy(out + total, work, tris*3*sizeof(uint));
+        mesh->lods[mesh->lod_count++] = (sogv_mesh_lod){
+            .first_index = total,
+            .indice_count = tris*3,
+            .error = sqrt(ctx.max_cost),
+        };
+        total += tris*3;
+    }
+    mesh->indices = out;
+
+    free(ctx.group);
+    free(ctx.wedge_next);
+    free(ctx.bone);
+    free(ctx.remap);
+    free(ctx.map);
+    free(ctx.tris);
+    free(ctx.half_open);
+    free(ctx.collapses);
+    free(ctx.quadrics);
+    free(ctx.tri_offsets);
+    free(ctx.tri_fill);
+    free(ctx.group_open);
+    free(ctx.locked);
+    free(work);
+}
+
+void sogv_model_lod_errors(sogv_model* model) {
+    model->lod_count = 1;
+    for(size_t i=0; i<model->mesh_count; ++i)
+        if(model->meshes[i].lod_count > model->lod_count) model->lod_count = model->meshes[i].lod_count;
+    for(size_t l=0; l<model->lod_count; ++l) {
+        float error = l ? model->lod_errors[l-1] : 0.0f;
+        for(size_t i=0; i<model->mesh_count; ++i) {
+            sogv_mesh_lod lod = sogv_mesh_lod_get(&model->meshes[i], l);
+            if(lod.error > error) error = lod.error;
+        }
+        model->lod_errors[l] = error;
+    }
+}
+
+// Pixels one model unit spans at the near side of the bounding sphere
+float sogv_model_screen_scale(const sogv_model* model, mat4x4 transform, vec3 eye, float proj_y, float viewport_h) {
+    vec4 c = {model->center[0], model->center[1], model->center[2], 1.0f}, world;
+    mat4x4_mul_vec4(world, transform, c);
+    float max_scale2 = 0.0f;
+    for(int col=0; col<3; ++col) {
+        float s2 = vec3_mul_inner(transform[col], transform[col]);
+        if(s2 > max_scale2) max_scale2 = s2;
+    }
+    const float scale = sqrtf(max_scale2);
+    vec3 d;
+    vec3_sub(d, world, eye);
+    float dist = vec3_len(d) - model->radius*scale;
+    if(dist <= 0.0f) return INFINITY;
+    return scale * proj_y * viewport_h * 0.5f / dist;
+}
+
+// Coarsest level whose error covers at most max_px. A level is only left for a coarser one
+// once that one is under max_px by the hysteresis margin, and for a finer one once its own
+// error is over by the same margin, so objects near a threshold do not flicker.
+size_t sogv_model_lod_select(const sogv_model* model, float screen_scale, float max_px, float hysteresis, size_t current) {
+    const size_t levels = model->lod_count ? model->lod_count : 1;
+    if(current >= levels) current = levels-1;
+    while(current > 0 && model->lod_errors[current]*screen_scale > max_px*(1.0f + hysteresis)) current--;
+    while(current+1 < levels && model->lod_errors[current+1]*screen_scale < max_px*(1.0f - hysteresis)) current++;
+    return current;
+}
@@ -0,0 +1,106 @@
+#include <sogv.h>
+
+// Per-draw data for glMultiDrawElementsBaseVertex. GL 3.3 has no gl_DrawID and no base
+// instance, so draws are told apart by vertex: gl_VertexID includes the base vertex, and
+// every draw of a batch owns its own vertex range starting at its base vertex. The base
+// vertices (ascending) and the draws' model and normal matrices go into two buffer textures
+// the vertex shader searches and fetches from. With the stream ring running, both views
+// cover the ring and each batch is one block in it, found through the first texel uniforms;
+// without it, or when the ring is too big to view, two buffers are orphaned per batch like
+// the instance stream.
+
+static struct {
+    GLuint transform_buf, transform_tex;
+    GLuint base_buf, base_tex;
+    size_t cap;
+    // buffer the texture views currently show
+    GLuint viewed;
+    GLint max_texels;
+    // set once a ring block landed past what the views reach
+    bool ring_too_big;
+} md;
+
+static void multidraw_create() {
+    if(md.transform_buf) return;
+    md.cap = 64;
+    glGenBuffers(1, &md.transform_buf);
+    glGenBuffers(1, &md.base_buf);
+    glGenTextures(1, &md.transform_tex);
+    glGenTextures(1, &md.base_tex);
+
+    sogv_gl_bind_buffer(GL_TEXTURE_BUFFER, md.transform_buf);
+    glBufferData(GL_TEXTURE_BUFFER, md.cap*sizeof(sogv_instance_data), NULL, GL_STREAM_DRAW);
+    sogv_gl_bind_texture_buffer(SOGV_DRAW_TRANSFORMS_UNIT, md.transform_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, md.transform_buf);
+
+    sogv_gl_bind_buffer(GL_TEXTURE_BUFFER, md.base_buf);
+    glBufferData(GL_TEXTURE_BUFFER, md.cap*sizeof(GLint), NULL, GL_STREAM_DRAW);
+    sogv_gl_bind_texture_buffer(SOGV_DRAW_BASES_UNIT, md.base_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, md.base_buf);
+    md.viewed = md.transform_buf;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &md.max_texels);
+    sogv_gl_check("creating multi-draw buffers");
+}
+
+static void multidraw_view(GLuint transforms, GLuint bases) {
+    if(md.viewed == transforms) return;
+    sogv_gl_bind_texture_buffer(SOGV_DRAW_TRANSFORMS_UNIT, md.transform_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transforms);
+    sogv_gl_bind_texture_buffer(SOGV_DRAW_BASES_UNIT, md.base_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, bases);
+    md.viewed = transforms;
+}
+
+// Block in the stream ring, if the R32I view reaches every byte of it
+static bool multidraw_stream(const sogv_instance_data* data, const GLint* bases, size_t count,
+        GLint* transform_first, GLint* base_first) {
+    if(!sogv_stream_active() || md.ring_too_big) return false;
+    const size_t transform_bytes = count*sizeof(sogv_instance_data);
+    sogv_stream_block block = sogv_stream_alloc(transform_bytes + count*sizeof(GLint), 4*sizeof(float));
+    if((size_t)block.offset + block.size > (size_t)md.max_texels*sizeof(GLint)) {
+        sogv_log("Stream ring is larger than a buffer texture can view; multi-draws use their own buffers");
+        md.ring_too_big = true;
+        return false;
+    }
+    memcpy(block.ptr, data, transform_bytes);
+    memcpy((unsigned char*)block.ptr + transform_bytes, bases, count*sizeof(GLint));
+    sogv_stream_flush();
+    multidraw_view(block.buffer, block.buffer);
+    *transform_first = block.offset / (4*sizeof(float));
+    *base_first = (block.offset + transform_bytes) / sizeof(GLint);
+    return true;
+}
+
+void sogv_multidraw_upload(GLuint program, const sogv_instance_data* data, const GLint* bases, size_t count) {
+    multidraw_create();
+    GLint transform_first = 0, base_first = 0;
+    if(!multidraw_stream(data, bases, count, &transform_first, &base_first)) {
+        // growing keeps the buffer names, so the texture views stay attached
+        while(md.cap < count) md.cap *= 2;
+        sogv_gl_bind_buffer(GL_TEXTURE_BUFFER, md.transform_buf);
+        glBufferData(GL_TEXTURE_BUFFER, md.cap*sizeof(sogv_instance_data), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count*sizeof(sogv_instance_data), data);
+        sogv_gl_bind_buffer(GL_TEXTURE_BUFFER, md.base_buf);
+        glBufferData(GL_TEXTURE_BUFFER, md.cap*sizeof(GLint), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count*sizeof(GLint), bases);
+        multidraw_view(md.transform_buf, md.base_buf);
+    }
+
+    sogv_gl_bind_texture_buffer(SOGV_DRAW_TRANSFORMS_UNIT, md.transform_tex);
+    sogv_gl_bind_texture_buffer(SOGV_DRAW_BASES_UNIT, md.base_tex);
+    sogv_gl_uniform_set_by_name(program, SOGV_DRAW_TRANSFORMS, 1, (int[]){SOGV_DRAW_TRANSFORMS_UNIT});
+    sogv_gl_uniform_set_by_name(program, SOGV_DRAW_BASES, 1, (int[]){SOGV_DRAW_BASES_UNIT});
+    sogv_gl_uniform_set_by_name(program, SOGV_DRAW_COUNT, 1, (int[]){(int)count});
+    sogv_gl_uniform_set_by_name(program, SOGV_DRAW_TRANSFORM_FIRST, 1, &transform_first);
+    sogv_gl_uniform_set_by_name(program, SOGV_DRAW_BASE_FIRST, 1, &base_first);
+}
+
+void sogv_multidraw_free() {
+    if(md.transform_buf) {
+        sogv_gl_delete_buffers(1, &md.transform_buf);
+        sogv_gl_delete_buffers(1, &md.base_buf);
+        sogv_gl_delete_textures(1, &md.transform_tex);
+        sogv_gl_delete_textures(1, &md.base_tex);
+    }
+    memset(&md, 0, sizeof(md));
+}
@@ -0,0 +1,311 @@
+#include <sogv.h>
+
+// CPU occlusion culling after masked / hierarchical software occlusion culling: designated
+// occluders are rasterized at low resolution into a buffer of 1/w (larger is closer, 0 is
+// empty), one band of tile rows per job, four pixels at a time with SSE where there is SSE.
+// Every 8x8 tile keeps its farthest value, so most occludee tests settle per tile and only
+// tiles an occludee could peek through are read pixel by pixel.
+//
+// Occluders are sampled at pixel centres, so they may cover up to half a low-res pixel more
+// than they do at full resolution; keep them a little inside the geometry they stand for.
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define OCC_SSE
+#endif
+
+#define OCC_TILE 8
+// boxes reaching this close to the eye plane are simply visible
+#define OCC_NEAR_W 1e-4f
+
+typedef struct sogv_occluder_tri {
+    // edge functions a*x + b*y + c, positive inside, and 1/w as a plane over the screen
+    float ea[3], eb[3], ec[3];
+    float ra, rb, rc;
+    // pixel rectangle, inclusive
+    int x0, y0, x1, y1;
+} sogv_occluder_tri;
+
+typedef struct sogv_occlusion_band {
+    sogv_occlusion* occ;
+    int index;
+    uint32_t fill;
+} sogv_occlusion_band;
+
+sogv_occlusion* sogv_occlusion_create(int w, int h) {
+    sogv_occlusion* occ = calloc(1, sizeof(sogv_occlusion));
+    if(!occ) sogv_die("Could not allocate occlusion buffer");
+    occ->tiles_x = (w + OCC_TILE-1) / OCC_TILE;
+    occ->tiles_y = (h + OCC_TILE-1) / OCC_TILE;
+    if(occ->tiles_x < 1) occ->tiles_x = 1;
+    if(occ->tiles_y < 1) occ->tiles_y = 1;
+    occ->w = occ->tiles_x * OCC_TILE;
+    occ->h = occ->tiles_y * OCC_TILE;
+    occ->depth = calloc(occ->w * occ->h, sizeof(float));
+    occ->tile_min = calloc(occ->tiles_x * occ->tiles_y, sizeof(float));
+    occ->band_offsets = calloc(occ->tiles_y + 1, sizeof(uint32_t));
+    occ->bands = calloc(occ->tiles_y, sizeof(sogv_occlusion_band));
+    if(!occ->depth || !occ->tile_min || !occ->band_offsets || !occ->bands)
+        sogv_die("Could not allocate occlusion buffer");
+    for(int b=0; b<occ->tiles_y; ++b) occ->bands[b] = (sogv_occlusion_band){ .occ = occ, .index = b };
+    mat4x4_identity(occ->vp);
+    return occ;
+}
+
+void sogv_occlusion_free(sogv_occlusion* occ) {
+    free(occ->depth);
+    free(occ->tile_min);
+    free(occ->tris);
+    free(occ->band_offsets);
+    free(occ->band_tris);
+    free(occ->bands);
+    free(occ->scratch);
+    free(occ);
+}
+
+void sogv_occlusion_begin(sogv_occlusion* occ, mat4x4 vp) {
+    mat4x4_dup(occ->vp, vp);
+    occ->tri_count = 0;
+}
+
+// Screen space vertex: pixel x, y and 1/w
+static void occ_project(const sogv_occlusion* occ, const float* clip, float* out) {
+    const float r = 1.0f / clip[3];
+    out[0] = (clip[0]*r*0.5f + 0.5f) * occ->w;
+    out[1] = (clip[1]*r*0.5f + 0.5f) * occ->h;
+    out[2] = r;
+}
+
+static void occ_tri_setup(sogv_occlusion* occ, const float* a, const float* b, const float* c) {
+    const float det = (b[0]-a[0])*(c[1]-a[1]) - (c[0]-a[0])*(b[1]-a[1]);
+    if(fabsf(det) < 1e-8f) return;
+
+    // pixels whose centre may be inside
+    const float min_x = fminf(a[0], fminf(b[0], c[0])), max_x = fmaxf(a[0], fmaxf(b[0], c[0]));
+    const float min_y = fminf(a[1], fminf(b[1], c[1])), max_y = fmaxf(a[1], fmaxf(b[1], c[1]));
+    const int x0 = min_x < 0.0f ? 0 : (int)ceilf(min_x - 0.5f);
+    const int y0 = min_y < 0.0f ? 0 : (int)ceilf(min_y - 0.5f);
+    const int x1 = max_x >= occ->w ? occ->w-1 : (int)floorf(max_x - 0.5f);
+    const int y1 = max_y >= occ->h ? occ->h-1 : (int)floorf(max_y - 0.5f);
+    if(x0 > x1 || y0 > y1) return;
+
+    if(occ->tri_count == occ->tri_cap) {
+        occ->tri_cap = occ->tri_cap ? occ->tri_cap*2 : 256;
+        sogv_arr_resize(sogv_occluder_tri, occ->tris, occ->tri_cap*sizeof(sogv_occluder_tri));
+    }
+    sogv_occluder_tri* t = &occ->tris[occ->tri_count++];
+    const float* v[3] = {a, b, c};
+    // either winding: occluders count from both sides
+    const float s = det > 0.0f ? 1.0f : -1.0f;
+    for(int e=0; e<3; ++e) {
+        const float* p = v[e];
+        const float* q = v[(e+1)%3];
+        t->ea[e] = s * (p[1] - q[1]);
+        t->eb[e] = s * (q[0] - p[0]);
+        t->ec[e] = s * (p[0]*q[1] - q[0]*p[1]);
+    }
+    const float dx1 = b[0]-a[0], dy1 = b[1]-a[1], dr1 = b[2]-a[2];
+    const float dx2 = c[0]-a[0], dy2 = c[1]-a[1], dr2 = c[2]-a[2];
+    t->ra = (dr1*dy2 - dr2*dy1) / det;
+    t->rb = (dx1*dr2 - dx2*dr1) / det;
+    t->rc = a[2] - t->ra*a[0] - t->rb*a[1];
+    t->x0 = x0;
+    t->y0 = y0;
+    t->x1 = x1;
+    t->y1 = y1;
+}
+
+// Sutherland-Hodgman against the near plane (z >= -w), then fans of whatever is left
+static void occ_tri_clip(sogv_occlusion* occ, const float* c0, const float* c1, const float* c2) {
+    const float* in[3] = {c0, c1, c2};
+    // all outside one side plane: nothing to draw
+    for(int k=0; k<2; ++k) {
+        if(c0[k] > c0[3] && c1[k] > c1[3] && c2[k] > c2[3]) return;
+        if(c0[k] < -c0[3] && c1[k] < -c1[3] && c2[k] < -c2[3]) return;
+    }
+
+    vec4 poly[4];
+    int n = 0;
+    for(int i=0; i<3; ++i) {
+        const float* p = in[i];
+        const float* q = in[(i+1)%3];
+        const float dp = p[2] + p[3], dq = q[2] + q[3];
+        if(dp >= 0.0f) vec4_dup(poly[n++], (float*)p);
+        if((dp >= 0.0f) != (dq >= 0.0f)) {
+            const float t = dp / (dp - dq);
+            for(int k=0; k<4; ++k) poly[n][k] = p[k] + (q[k] - p[k])*t;
+            n++;
+        }
+    }
+    if(n < 3) return;
+
+    float screen[4][3];
+    for(int i=0; i<n; ++i) {
+        if(poly[i][3] <= 0.0f) return;
+        occ_project(occ, poly[i], screen[i]);
+    }
+    for(int i=2; i<n; ++i) occ_tri_setup(occ, screen[0], screen[i-1], screen[i]);
+}
+
+void sogv_occlusion_add_occluder(sogv_occlusion* occ, const float* positions, size_t stride, size_t vert_count,
+        const uint* indices, size_t index_count, mat4x4 transform) {
+    if(vert_count > occ->scratch_cap) {
+        occ->scratch_cap = vert_count;
+        sogv_arr_resize(vec4, occ->scratch, occ->scratch_cap*sizeof(vec4));
+    }
+    mat4x4 mvp;
+    mat4x4_mul(mvp, occ->vp, transform);
+    for(size_t i=0; i<vert_count; ++i) {
+        const float* p = (const float*)((const unsigned char*)positions + i*stride);
+        vec4 pos = {p[0], p[1], p[2], 1.0f};
+        mat4x4_mul_vec4(occ->scratch[i], mvp, pos);
+    }
+    for(size_t i=0; i+2<index_count; i+=3) {
+        if(indices[i] >= vert_count || indices[i+1] >= vert_count || indices[i+2] >= vert_count) continue;
+        occ_tri_clip(occ, occ->scratch[indices[i]], occ->scratch[indices[i+1]], occ->scratch[indices[i+2]]);
+    }
+}
+
+void sogv_occlusion_add_mesh(sogv_occlusion* occ, const sogv_mesh* mesh, mat4x4 transform) {
+    if(!mesh->verts) return;
+    sogv_occlusion_add_occluder(occ, mesh->verts[0].pos, sizeof(sogv_vert), mesh->vert_count,
+            mesh->indices, mesh->indice_count, transform);
+}
+
+static void occ_band_work(void* arg) {
+    sogv_occlusion_band* band = arg;
+    sogv_occlusion* occ = band->occ;
+    const int w = occ->w;
+    const int band_y0 = band->index*OCC_TILE, band_y1 = band_y0 + OCC_TILE-1;
+    memset(&occ->depth[band_y0*w], 0, OCC_TILE*w*sizeof(float));
+
+    for(uint32_t i=occ->band_offsets[band->index]; i<occ->band_offsets[band->index+1]; ++i) {
+        const sogv_occluder_tri* t = &occ->tris[occ->band_tris[i]];
+        const int y0 = t->y0 > band_y0 ? t->y0 : band_y0;
+        const int y1 = t->y1 < band_y1 ? t->y1 : band_y1;
+        for(int y=y0; y<=y1; ++y) {
+            float* row = &occ->depth[y*w];
+            const float py = y + 0.5f;
+#ifdef OCC_SSE
+            // rows are a whole number of tiles wide, so four aligned lanes never leave the row
+            const int x_start = t->x0 & ~3;
+            const __m128 zero = _mm_setzero_ps(), four = _mm_set1_ps(4.0f);
+            const __m128 ea0 = _mm_set1_ps(t->ea[0]), ea1 = _mm_set1_ps(t->ea[1]), ea2 = _mm_set1_ps(t->ea[2]);
+            const __m128 ra = _mm_set1_ps(t->ra);
+            const __m128 e0y = _mm_set1_ps(t->eb[0]*py + t->ec[0]);
+            const __m128 e1y = _mm_set1_ps(t->eb[1]*py + t->ec[1]);
+            const __m128 e2y = _mm_set1_ps(t->eb[2]*py + t->ec[2]);
+            const __m128 ry = _mm_set1_ps(t->rb*py + t->rc);
+            __m128 px = _mm_add_ps(_mm_set1_ps(x_start + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+            for(int x=x_start; x<=t->x1; x+=4) {
+                __m128 in = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ea0, px), e0y), zero);
+                in = _mm_and_ps(in, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ea1, px), e1y), zero));
+                in = _mm_and_ps(in, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ea2, px), e2y), zero));
+                __m128 r = _mm_and_ps(in, _mm_add_ps(_mm_mul_ps(ra, px), ry));
+                _mm_storeu_ps(row + x, _mm_max_ps(_mm_loadu_ps(row + x), r));
+                px = _mm_add_ps(px, four);
+            }
+#else
+            for(int x=t->x0; x<=t->x1; ++x) {
+                const float px = x + 0.5f;
+                bool in = true;
+                for(int e=0; e<3 && in; ++e) in = t->ea[e]*px + t->eb[e]*py + t->ec[e] >= 0.0f;
+                if(!in) continue;
+                const float r = t->ra*px + t->rb*py + t->rc;
+                if(r > row[x]) row[x] = r;
+            }
+#endif
+        }
+    }
+
+    for(int tx=0; tx<occ->tiles_x; ++tx) {
+        float farthest = INFINITY;
+        for(int y=band_y0; y<=band_y1; ++y)
+            for(int x=tx*OCC_TILE; x<(tx+1)*OCC_TILE; ++x)
+                if(occ->depth[y*w + x] < farthest) farthest = occ->depth[y*w + x];
+        occ->tile_min[band->index*occ->tiles_x + tx] = farthest;
+    }
+}
+
+void sogv_occlusion_rasterize(sogv_occlusion* occ) {
+    // bin triangles into the bands they touch
+    memset(occ->band_offsets, 0, (occ->tiles_y+1)*sizeof(uint32_t));
+    for(size_t i=0; i<occ->tri_count; ++i)
+        for(int b=occ->tris[i].y0/OCC_TILE; b<=occ->tris[i].y1/OCC_TILE; ++b) occ->band_offsets[b+1]++;
+    for(int b=0; b<occ->tiles_y; ++b) {
+        occ->band_offsets[b+1] += occ->band_offsets[b];
+        occ->bands[b].fill = occ->band_offsets[b];
+    }
+    if(occ->band_offsets[occ->tiles_y] > occ->band_tris_cap) {
+        occ->band_tris_cap = occ->band_offsets[occ->tiles_y];
+        sogv_arr_resize(uint32_t, occ->band_tris, occ->band_tris_cap*sizeof(uint32_t));
+    }
+    for(size_t i=0; i<occ->tri_count; ++i)
+        for(int b=occ->tris[i].y0/OCC_TILE; b<=occ->tris[i].y1/OCC_TILE; ++b)
+            occ->band_tris[occ->bands[b].fill++] = i;
+
+    sogv_job_group group = {0};
+    for(int b=0; b<occ->tiles_y; ++b) sogv_job_push_group(&group, occ_band_work, &occ->bands[b]);
+    sogv_jobs_wait(&group);
+}
+
+bool sogv_occlusion_visible(const sogv_occlusion* occ, const vec3 center, const vec3 extents) {
+    // corners in clip space are the centre plus or minus each scaled axis column
+    float c[4], axis[3][4];
+    for(int k=0; k<4; ++k) {
+        c[k] = occ->vp[0][k]*center[0] + occ->vp[1][k]*center[1] + occ->vp[2][k]*center[2] + occ->vp[3][k];
+        for(int a=0; a<3; ++a) axis[a][k] = occ->vp[a][k]*extents[a];
+    }
+    // the nearest corner is the one with the smallest w
+    if(c[3] - fabsf(axis[0][3]) - fabsf(axis[1][3]) - fabsf(axis[2][3]) <= OCC_NEAR_W) return true;
+
+    // corners by doubling out from the lowest one, then projected
+    float corners[8][4];
+    for(int k=0; k<4; ++k) {
+        corners[0][k] = c[k] - axis[0][k] - axis[1][k] - axis[2][k];
+        corners[1][k] = corners[0][k] + 2.0f*axis[0][k];
+    }
+    for(int i=0; i<2; ++i)
+        for(int k=0; k<4; ++k) corners[2+i][k] = corners[i][k] + 2.0f*axis[1][k];
+    for(int i=0; i<4; ++i)
+        for(int k=0; k<4; ++k) corners[4+i][k] = corners[i][k] + 2.0f*axis[2][k];
+
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY, nearest = 0.0f;
+    for(int corner=0; corner<8; ++corner) {
+        float screen[3];
+        occ_project(occ, corners[corner], screen);
+        if(screen[0] < min_x) min_x = screen[0];
+        if(screen[0] > max_x) max_x = screen[0];
+        if(screen[1] < min_y) min_y = screen[1];
+        if(screen[1] > max_y) max_y = screen[1];
+        if(screen[2] > nearest) nearest = screen[2];
+    }
+    // off screen is the frustum test's call
+    if(max_x < 0.0f || max_y < 0.0f || min_x >= occ->w || min_y >= occ->h) return true;
+    const int x0 = min_x < 0.0f ? 0 : (int)min_x;
+    const int y0 = min_y < 0.0f ? 0 : (int)min_y;
+    const int x1 = max_x >= occ->w ? occ->w-1 : (int)max_x;
+    const int y1 = max_y >= occ->h ? occ->h-1 : (int)max_y;
+
+    for(int ty=y0/OCC_TILE; ty<=y1/OCC_TILE; ++ty)
+        for(int tx=x0/OCC_TILE; tx<=x1/OCC_TILE; ++tx) {
+            if(nearest < occ->tile_min[ty*occ->tiles_x + tx]) continue;
+            const int px0 = tx*OCC_TILE > x0 ? tx*OCC_TILE : x0, px1 = (tx+1)*OCC_TILE-1 < x1 ? (tx+1)*OCC_TILE-1 : x1;
+            const int py0 = ty*OCC_TILE > y0 ? ty*OCC_TILE : y0, py1 = (ty+1)*OCC_TILE-1 < y1 ? (ty+1)*OCC_TILE-1 : y1;
+            for(int y=py0; y<=py1; ++y)
+                for(int x=px0; x<=px1; ++x)
+                    if(occ->depth[y*occ->w + x] <= nearest) return true;
+        }
+    return false;
+}
+
+size_t sogv_occlusion_cull(const sogv_occlusion* occ, const sogv_cull_bounds* b, uint32_t* visible_idx, size_t count) {
+    size_t kept = 0;
+    for(size_t i=0; i<count; ++i) {
+        const uint32_t idx = visible_idx[i];
+        const vec3 center = {b->cx[idx], b->cy[idx], b->cz[idx]};
+        const vec3 extents = {b->ex[idx], b->ey[idx], b->ez[idx]};
+        if(sogv_occlusion_visible(occ, center, extents)) visible_idx[kept++] = idx;
+    }
+    return kept;
+}
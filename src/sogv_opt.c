@@ -0,0 +1,276 @@
+#include <sogv.h>
+
+// Import-time index optimization. Triangles are reordered with Forsyth's linear-speed vertex
+// cache algorithm, optionally regrouped for overdraw (cache-friendly clusters sorted so the
+// outward facing ones draw first), and vertices are then renumbered in first use order.
+// Whole sogv_vert entries move, so bone ids and weights travel with their vertex.
+
+#define OPT_CACHE_SIZE 32
+#define OPT_VALENCE_MAX 32
+
+static float opt_cache_scores[OPT_CACHE_SIZE];
+static float opt_valence_scores[OPT_VALENCE_MAX];
+static SDL_SpinLock opt_tables_lock;
+static bool opt_tables_ready;
+
+static void opt_tables_init() {
+    SDL_AtomicLock(&opt_tables_lock);
+    if(!opt_tables_ready) {
+        for(size_t i=0; i<OPT_CACHE_SIZE; ++i)
+            // the last triangle's vertices get a fixed score so it is not simply repeated
+            opt_cache_scores[i] = i < 3 ? 0.75f :
+                powf(1.0f - (float)(i-3) / (OPT_CACHE_SIZE-3), 1.5f);
+        for(size_t i=1; i<OPT_VALENCE_MAX; ++i)
+            opt_valence_scores[i] = 2.0f * powf((float)i, -0.5f);
+        opt_tables_ready = true;
+    }
+    SDL_AtomicUnlock(&opt_tables_lock);
+}
+
+static float opt_vertex_score(int cache_pos, uint valence) {
+    if(valence == 0) return -1.0f;
+    float score = cache_pos >= 0 && cache_pos < OPT_CACHE_SIZE ? opt_cache_scores[cache_pos] : 0.0f;
+    return score + (valence < OPT_VALENCE_MAX ? opt_valence_scores[valence] : 2.0f * powf((float)valence, -0.5f));
+}
+
+sogv_cache_stats sogv_mesh_cache_stats(const sogv_mesh* mesh, size_t cache_size) {
+    sogv_cache_stats stats = {0};
+    size_t tri_count = mesh->indice_count / 3;
+    if(!tri_count || !cache_size) return stats;
+
+    // FIFO like most post-transform caches; stamp holds the miss counter when a vertex entered
+    size_t* stamp = calloc(mesh->vert_count, sizeof(size_t));
+    if(!stamp) sogv_die("Could not allocate cache simulation");
+    size_t misses = 0, used = 0;
+    for(size_t i=0; i<tri_count*3; ++i) {
+        uint v = mesh->indices[i];
+        if(stamp[v] == 0) used++;
+        if(stamp[v] == 0 || misses - stamp[v] >= cache_size) {
+            misses++;
+            stamp[v] = misses;
+        }
+    }
+    free(stamp);
+
+    stats.acmr = (float)misses / tri_count;
+    stats.atvr = used ? (float)misses / used : 0.0f;
+    return stats;
+}
+
+static void opt_cache_order(uint* indices, size_t tri_count, size_t vert_count) {
+    uint* adj_offsets = calloc(vert_count+1, sizeof(uint));
+    uint* valence = calloc(vert_count, sizeof(uint));
+    uint* adj = malloc(tri_count*3*sizeof(uint));
+    int* cache_pos = malloc(vert_count*sizeof(int));
+    float* vert_score = malloc(vert_count*sizeof(float));
+    bool* emitted = calloc(tri_count, sizeof(bool));
+    uint* out = malloc(tri_count*3*sizeof(uint));
+    if(!adj_offsets || !valence || !adj || !cache_pos || !vert_score || !emitted || !out)
+        sogv_die("Could not allocate vertex cache optimizer");
+
+    for(size_t i=0; i<tri_count*3; ++i) valence[indices[i]]++;
+    for(size_t v=0; v<vert_count; ++v) adj_offsets[v+1] = adj_offsets[v] + valence[v];
+    {
+        uint* fill = calloc(vert_count, sizeof(uint));
+        if(!fill) sogv_die("Could not allocate vertex cache optimizer");
+        for(size_t i=0; i<tri_count*3; ++i) {
+            uint v = indices[i];
+            adj[adj_offsets[v] + fill[v]++] = i/3;
+        }
+        free(fill);
+    }
+
+    for(size_t v=0; v<vert_count; ++v) {
+        cache_pos[v] = -1;
+        vert_score[v] = opt_vertex_score(-1, valence[v]);
+    }
+
+    // cache holds up to three extra entries while a triangle is pushed in
+    uint cache[OPT_CACHE_SIZE+3], next_cache[OPT_CACHE_SIZE+3];
+    size_t cache_count = 0;
+    size_t cursor = 0;
+    long best = -1;
+
+    for(size_t emit=0; emit<tri_count; ++emit) {
+        if(best < 0) {
+            // dead end: take the next triangle nothing in the cache reaches
+            while(emitted[cursor]) cursor++;
+            best = cursor;
+        }
+        const uint* tri = &indices[best*3];
+        emitted[best] = true;
+        memcpy(&out[emit*3], tri, 3*sizeof(uint));
+
+        size_t next_count = 0;
+        for(size_t k=0; k<3; ++k) {
+            uint v = tri[k];
+            next_cache[next_count++] = v;
+            // drop the emitted triangle from the vertex's live adjacency
+            uint* list = &adj[adj_offsets[v]];
+            for(uint j=0; j<valence[v]; ++j)
+                if(list[j] == (uint)best) {
+                    list[j] = list[--valence[v]];
+                    break;
+                }
+        }
+        for(size_t i=0; i<cache_count; ++i) {
+            uint v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2]) next_cache[next_count++] = v;
+        }
+
+        for(size_t i=0; i<next_count; ++i) {
+            uint v = next_cache[i];
+            cache_pos[v] = i < OPT_CACHE_SIZE ? (int)i : -1;
+            vert_score[v] = opt_vertex_score(cache_pos[v], valence[v]);
+        }
+        cache_count = next_count < OPT_CACHE_SIZE ? next_count : OPT_CACHE_SIZE;
+        memcpy(cache, next_cache, cache_count*sizeof(uint));
+
+        best = -1;
+        float best_score = -1.0f;
+        for(size_t i=0; i<cache_count; ++i) {
+            uint v = cache[i];
+            const uint* list = &adj[adj_offsets[v]];
+            for(uint j=0; j<valence[v]; ++j) {
+                uint t = list[j];
+                float score = vert_score[indices[t*3]] + vert_score[indices[t*3+1]] + vert_score[indices[t*3+2]];
+                if(score > best_score) {
+                    best_score = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, out, tri_count*3*sizeof(uint));
+    free(adj_offsets);
+    free(valence);
+    free(adj);
+    free(cache_pos);
+    free(vert_score);
+    free(emitted);
+    free(out);
+}
+
+typedef struct opt_cluster {
+    size_t first, count;
+    float sort_key;
+} opt_cluster;
+
+static int opt_cluster_cmp(const void* a, const void* b) {
+    float ka = ((const opt_cluster*)a)->sort_key, kb = ((const opt_cluster*)b)->sort_key;
+    return ka < kb ? 1 : ka > kb ? -1 : 0;
+}
+
+// Splits the cache ordered list where the cache starts over (all three vertices miss) and
+// draws clusters facing away from the mesh centre first, as they tend to occlude the rest.
+static void opt_overdraw_order(uint* indices, size_t tri_count, const sogv_vert* verts, size_t vert_count) {
+    size_t* stamp = calloc(vert_count, sizeof(size_t));
+    opt_cluster* clusters = malloc(tri_count*sizeof(opt_cluster));
+    uint* out = malloc(tri_count*3*sizeof(uint));
+    if(!stamp || !clusters || !out) sogv_die("Could not allocate overdraw optimizer");
+
+    vec3 centre = {0.0f, 0.0f, 0.0f};
+    for(size_t i=0; i<tri_count*3; ++i) vec3_add(centre, centre, verts[indices[i]].pos);
+    vec3_scale(centre, centre, 1.0f / (tri_count*3));
+
+    size_t cluster_count = 0, misses = 0;
+    for(size_t t=0; t<tri_count; ++t) {
+        size_t tri_misses = 0;
+        for(size_t k=0; k<3; ++k) {
+            uint v = indices[t*3+k];
+            if(stamp[v] == 0 || misses - stamp[v] >= OPT_CACHE_SIZE) {
+                misses++;
+                tri_misses++;
+                stamp[v] = misses;
+            }
+        }
+        if(tri_misses == 3 || cluster_count == 0)
+            clusters[cluster_count++] = (opt_cluster){ .first = t, .count = 0 };
+        clusters[cluster_count-1].count++;
+    }
+
+    for(size_t c=0; c<cluster_count; ++c) {
+        opt_cluster* cluster = &clusters[c];
+        vec3 area_normal = {0.0f, 0.0f, 0.0f}, mid = {0.0f, 0.0f, 0.0f};
+        for(size_t t=cluster->first; t<cluster->first+cluster->count; ++t) {
+            const float* a = verts[indices[t*3]].pos;
+            const float* b = verts[indices[t*3+1]].pos;
+            const float* c3 = verts[indices[t*3+2]].pos;
+            vec3 ab, ac, n;
+            vec3_sub(ab, b, a);
+            vec3_sub(ac, c3, a);
+            vec3_mul_cross(n, ab, ac);
+            vec3_add(area_normal, area_normal, n);
+            vec3_add(mid, mid, a);
+            vec3_add(mid, mid, b);
+            vec3_add(mid, mid, c3);
+        }
+        vec3_scale(mid, mid, 1.0f / (cluster->count*3));
+        vec3_sub(mid, mid, centre);
+        float len = vec3_len(area_normal);
+        cluster->sort_key = len > 0.0f ? vec3_mul_inner(mid, area_normal) / len : 0.0f;
+    }
+    qsort(clusters, cluster_count, sizeof(opt_cluster), opt_cluster_cmp);
+
+    size_t o = 0;
+    for(size_t c=0; c<cluster_count; ++c) {
+        memcpy(&out[o], &indices[clusters[c].first*3], clusters[c].count*3*sizeof(uint));
+        o += clusters[c].count*3;
+    }
+    memcpy(indices, out, tri_count*3*sizeof(uint));
+    free(stamp);
+    free(clusters);
+    free(out);
+}
+
+// Renumbers vertices in first use order; vertices no triangle uses are dropped. LOD levels
+// only use level 0 vertices, so they follow the same renumbering.
+static void opt_fetch_order(sogv_mesh* mesh) {
+    uint* remap = malloc(mesh->vert_count*sizeof(uint));
+    sogv_vert* verts = malloc(mesh->vert_count*sizeof(sogv_vert));
+    if(!remap || !verts) sogv_die("Could not allocate vertex fetch optimizer");
+    memset(remap, 0xff, mesh->vert_count*sizeof(uint));
+
+    uint next = 0;
+    for(size_t i=0; i<mesh->indice_count; ++i) {
+        uint v = mesh->indices[i];
+        if(remap[v] == UINT32_MAX) {
+            remap[v] = next;
+            verts[next++] = mesh->verts[v];
+        }
+        mesh->indices[i] = remap[v];
+    }
+    for(size_t i=mesh->indice_count; i<sogv_mesh_index_total(mesh); ++i)
+        mesh->indices[i] = remap[mesh->indices[i]];
+    free(remap);
+    free(mesh->verts);
+    mesh->verts = verts;
+    mesh->vert_count = next;
+}
+
+void sogv_mesh_optimize(sogv_mesh* mesh, bool overdraw) {
+    if(mesh->indice_count % 3 != 0) {
+        sogv_log("Mesh is not all triangles, skipping optimization");
+        return;
+    }
+    size_t tri_count = mesh->indice_count / 3;
+    if(!tri_count) return;
+    opt_tables_init();
+
+    sogv_cache_stats before = sogv_mesh_cache_stats(mesh, OPT_CACHE_SIZE);
+    for(size_t level=0; level<(mesh->lod_count ? mesh->lod_count : 1); ++level) {
+        const sogv_mesh_lod lod = sogv_mesh_lod_get(mesh, level);
+        uint* indices = mesh->indices + lod.first_index;
+        opt_cache_order(indices, lod.indice_count/3, mesh->vert_count);
+        if(overdraw) opt_overdraw_order(indices, lod.indice_count/3, mesh->verts, mesh->vert_count);
+    }
+    opt_fetch_order(mesh);
+    // keep copies made from the old order in step
+    if(mesh->short_indices) sogv_mesh_index_narrow(mesh);
+    if(mesh->packed) sogv_mesh_pack(mesh);
+    sogv_cache_stats after = sogv_mesh_cache_stats(mesh, OPT_CACHE_SIZE);
+
+    sogv_log_v("Mesh optimized: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+            before.acmr, after.acmr, before.atvr, after.atvr);
+}
@@ -0,0 +1,177 @@
+#include <sogv.h>
+
+// On-disk program binary cache. Programs built by sogv_gl_shader_create* are stored with
+// glGetProgramBinary in dir, one file per program, named by a 64-bit FNV-1a hash of both
+// sources and GL_RENDERER / GL_VERSION, so a driver or GPU change simply misses. Loading goes
+// through glProgramBinary; a binary the driver refuses, a short file or a stale header means
+// a normal compile, whose result then replaces the file. ARB_get_program_binary is core from
+// GL 4.1 and missing from the 3.3 loader, so the entry points come from SDL.
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    #define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+    #define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+    #define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP progcache_get_binary_fn)(GLuint program, GLsizei size, GLsizei* length, GLenum* format, void* binary);
+typedef void (APIENTRYP progcache_binary_fn)(GLuint program, GLenum format, const void* binary, GLsizei length);
+typedef void (APIENTRYP progcache_parameteri_fn)(GLuint program, GLenum pname, GLint value);
+
+#define PROGCACHE_MAGIC "SGPB"
+#define PROGCACHE_VERSION 1
+
+typedef struct progcache_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+} progcache_header;
+
+static struct {
+    char* dir;
+    uint64_t driver_hash;
+    progcache_get_binary_fn get_binary;
+    progcache_binary_fn binary;
+    progcache_parameteri_fn parameteri;
+    size_t hits;
+    size_t misses;
+    bool active;
+} pcache;
+
+// FNV-1a, 64-bit, continued from hash
+static uint64_t progcache_hash(uint64_t hash, const char* str) {
+    while(*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 1099511628211ull;
+    }
+    // keeps "ab" + "c" apart from "a" + "bc"
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+static uint64_t progcache_key(const char* vertex_code, const char* fragment_code) {
+    return progcache_hash(progcache_hash(pcache.driver_hash, vertex_code), fragment_code);
+}
+
+static char* progcache_path(uint64_t key) {
+    size_t len = strlen(pcache.dir) + 1 + 16 + 4 + 1;
+    char* path = malloc(len);
+    if(!path) sogv_die("Could not allocate program cache path");
+    snprintf(path, len, "%s/%016llx.bin", pcache.dir, (unsigned long long)key);
+    return path;
+}
+
+void sogv_gl_program_cache_init(const char* dir) {
+    if(pcache.active || !dir) return;
+    if(!SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+        sogv_log("No ARB_get_program_binary, shaders compile on every run");
+        return;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    pcache.get_binary = (progcache_get_binary_fn)SDL_GL_GetProcAddress("glGetProgramBinary");
+    pcache.binary = (progcache_binary_fn)SDL_GL_GetProcAddress("glProgramBinary");
+    pcache.parameteri = (progcache_parameteri_fn)SDL_GL_GetProcAddress("glProgramParameteri");
+    if(formats < 1 || !pcache.get_binary || !pcache.binary || !pcache.parameteri) {
+        sogv_log("Driver offers no program binary formats, shaders compile on every run");
+        memset(&pcache, 0, sizeof(pcache));
+        return;
+    }
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    pcache.driver_hash = progcache_hash(progcache_hash(14695981039346656037ull, renderer ? renderer : ""),
+            version ? version : "");
+    pcache.dir = strdup(dir);
+    if(!pcache.dir) sogv_die("Could not allocate program cache path");
+    pcache.active = true;
+    sogv_log_v("Program binary cache in %s", dir);
+}
+
+void sogv_gl_program_cache_quit() {
+    if(pcache.active) sogv_log_v("Program binary cache: %zu loaded, %zu compiled", pcache.hits, pcache.misses);
+    free(pcache.dir);
+    memset(&pcache, 0, sizeof(pcache));
+}
+
+void sogv_gl_program_cache_hint(GLuint program) {
+    if(pcache.active) pcache.parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+GLuint sogv_gl_program_cache_load(const char* vertex_code, const char* fragment_code) {
+    if(!pcache.active) return 0;
+    const uint64_t key = progcache_key(vertex_code, fragment_code);
+    char* path = progcache_path(key);
+    FILE* file = fopen(path, "rb");
+    free(path);
+    if(!file) {
+        pcache.misses++;
+        return 0;
+    }
+
+    progcache_header header;
+    void* binary = NULL;
+    if(fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, PROGCACHE_MAGIC, 4) == 0
+            && header.version == PROGCACHE_VERSION && header.key == key && header.length
+            && (binary = malloc(header.length)))
+        if(fread(binary, header.length, 1, file) != 1) free(binary), binary = NULL;
+    fclose(file);
+    if(!binary) {
+        pcache.misses++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    pcache.binary(program, header.format, binary, header.length);
+    free(binary);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    // drivers may refuse their own binaries after an update that kept GL_VERSION
+    if(!linked) {
+        glDeleteProgram(program);
+        // clear the error a refused binary may leave
+        while(glGetError() != GL_NO_ERROR) {}
+        sogv_log_v("Cached program %016llx was refused, compiling", (unsigned long long)key);
+        pcache.misses++;
+        return 0;
+    }
+    pcache.hits++;
+    return program;
+}
+
+void sogv_gl_program_cache_store(GLuint program, const char* vertex_code, const char* fragment_code) {
+    if(!pcache.active) return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length < 1) return;
+    void* binary = malloc(length);
+    if(!binary) sogv_die("Could not allocate program binary");
+    GLenum format = 0;
+    GLsizei written = 0;
+    pcache.get_binary(program, length, &written, &format, binary);
+    if(written < 1) {
+        free(binary);
+        return;
+    }
+
+    const uint64_t key = progcache_key(vertex_code, fragment_code);
+    progcache_header header = {
+        .magic = {'S', 'G', 'P', 'B'},
+        .version = PROGCACHE_VERSION,
+        .key = key,
+        .format = format,
+        .length = written,
+    };
+    char* path = progcache_path(key);
+    FILE* file = fopen(path, "wb");
+    bool ok = file && fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, written, 1, file) == 1;
+    if(file) fclose(file);
+    if(!ok) sogv_log_v("Could not write cached program %s", path);
+    free(path);
+    free(binary);
+}
@@ -0,0 +1,197 @@
+#include <sogv.h>
+
+// Hardware occlusion queries with conditional rendering. A queried draw runs under
+// glBeginConditionalRender on the query its object's bounding box filled the frame before,
+// with GL_QUERY_NO_WAIT so a result the GPU has not reached yet just lets the draw through.
+// The boxes are queued and drawn after the scene in sogv_query_frame_end, depth tested but
+// writing nothing, each inside a GL_ANY_SAMPLES_PASSED query. The CPU never waits: a slot is
+// read back a frame after its conditional draw, and only once available, to count what the
+// GPU dropped. Three slots per object keep the box, the conditional draw and the read back
+// of consecutive frames apart.
+
+// Boxes grow by this much so an object's own surfaces do not hide its box
+#define QUERY_BOX_PAD 1.02f
+
+typedef struct query_proxy {
+    sogv_query_object* obj;
+    size_t slot;
+    mat4x4 box;
+} query_proxy;
+
+static const float query_box_verts[8*3] = {
+    -1, -1, -1,  1, -1, -1,  1, 1, -1,  -1, 1, -1,
+    -1, -1, 1,  1, -1, 1,  1, 1, 1,  -1, 1, 1
+};
+static const unsigned char query_box_indices[36] = {
+    0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+    3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+};
+
+static const char* query_vert_code =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 pos;\n"
+    "uniform mat4 mvp;\n"
+    "void main() { gl_Position = mvp * vec4(pos, 1.0); }\n";
+static const char* query_frag_code =
+    "#version 330 core\n"
+    "void main() {}\n";
+
+static struct {
+    GLuint program;
+    sogv_uniform mvp;
+    GLuint vao, vbo, ebo;
+    mat4x4 vp;
+    query_proxy* proxies;
+    size_t proxy_count;
+    size_t proxy_cap;
+    // frames begun so far; slots issued in frame 0 do not exist
+    uint64_t frame;
+    sogv_query_stats stats;
+    sogv_query_stats last;
+} query;
+
+static void query_setup() {
+    if(query.program) return;
+    query.program = sogv_gl_shader_create_source(query_vert_code, query_frag_code);
+    query.mvp = sogv_gl_uniform_find(query.program, "mvp");
+
+    glGenVertexArrays(1, &query.vao);
+    glGenBuffers(1, &query.vbo);
+    glGenBuffers(1, &query.ebo);
+    sogv_gl_bind_vao(query.vao);
+    sogv_gl_bind_buffer(GL_ARRAY_BUFFER, query.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(query_box_verts), query_box_verts, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, query.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(query_box_indices), query_box_indices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    sogv_gl_check("creating occlusion query boxes");
+}
+
+// Counts a conditional draw once its query has a result; never waits for one
+static void query_read_back(sogv_query_object* obj, size_t slot) {
+    if(!obj->conditioned[slot]) return;
+    GLuint available = 0;
+    glGetQueryObjectuiv(obj->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available) return;
+    GLuint passed = 0;
+    glGetQueryObjectuiv(obj->queries[slot], GL_QUERY_RESULT, &passed);
+    if(!passed) query.stats.skipped++;
+    query.stats.read_back++;
+    obj->conditioned[slot] = false;
+}
+
+// Boxes reaching past the near plane cannot be judged by their faces
+static bool query_box_near_clipped(mat4x4 box) {
+    mat4x4 mvp;
+    mat4x4_mul(mvp, query.vp, box);
+    for(size_t c=0; c<8; ++c) {
+        vec4 corner = {query_box_verts[c*3], query_box_verts[c*3+1], query_box_verts[c*3+2], 1.0f}, clip;
+        mat4x4_mul_vec4(clip, mvp, corner);
+        if(clip[2] < -clip[3]) return true;
+    }
+    return false;
+}
+
+void sogv_query_frame_begin(mat4x4 vp) {
+    query.frame++;
+    mat4x4_dup(query.vp, vp);
+    memset(&query.stats, 0, sizeof(query.stats));
+    query.proxy_count = 0;
+}
+
+void sogv_model_render_queried(sogv_model* model, size_t level, mat4x4 transform, sogv_query_object* obj) {
+    if(!model->ready) return;
+    query.stats.draws++;
+
+    mat4x4 box;
+    mat4x4_translate(box, model->center[0], model->center[1], model->center[2]);
+    mat4x4_scale_aniso(box, box, (model->max[0] - model->min[0])*0.5f*QUERY_BOX_PAD,
+            (model->max[1] - model->min[1])*0.5f*QUERY_BOX_PAD, (model->max[2] - model->min[2])*0.5f*QUERY_BOX_PAD);
+    mat4x4_mul(box, transform, box);
+    if(!(model->radius > 0.0f) || query_box_near_clipped(box)) {
+        sogv_model_render_lod(model, level);
+        return;
+    }
+
+    if(!obj->queries[0]) glGenQueries(SOGV_QUERY_SLOTS, obj->queries);
+    const size_t slot = query.frame % SOGV_QUERY_SLOTS;
+    const size_t prev = (query.frame + SOGV_QUERY_SLOTS-1) % SOGV_QUERY_SLOTS;
+    const size_t older = (query.frame + SOGV_QUERY_SLOTS-2) % SOGV_QUERY_SLOTS;
+    query_read_back(obj, older);
+    // last try before the slot gets a new box; a result still missing now goes uncounted
+    query_read_back(obj, slot);
+    obj->conditioned[slot] = false;
+
+    if(obj->issued[prev] && obj->issued[prev] == query.frame-1) {
+        glBeginConditionalRender(obj->queries[prev], GL_QUERY_NO_WAIT);
+        sogv_model_render_lod(model, level);
+        glEndConditionalRender();
+        obj->conditioned[prev] = true;
+        query.stats.conditional++;
+    } else {
+        sogv_model_render_lod(model, level);
+    }
+
+    if(query.proxy_count == query.proxy_cap) {
+        query.proxy_cap = query.proxy_cap ? query.proxy_cap*2 : 64;
+        sogv_arr_resize(query_proxy, query.proxies, query.proxy_cap*sizeof(query_proxy));
+    }
+    query_proxy* proxy = &query.proxies[query.proxy_count++];
+    proxy->obj = obj;
+    proxy->slot = slot;
+    mat4x4_dup(proxy->box, box);
+}
+
+void sogv_query_frame_end() {
+    if(query.proxy_count) {
+        query_setup();
+        const bool cull = sogv_gl_enabled(GL_CULL_FACE), depth = sogv_gl_enabled(GL_DEPTH_TEST);
+        // from inside the depth range the back faces still count
+        sogv_gl_set_enabled(GL_CULL_FACE, false);
+        sogv_gl_set_enabled(GL_DEPTH_TEST, true);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        sogv_gl_use_program(query.program);
+        sogv_gl_bind_vao(query.vao);
+
+        for(size_t i=0; i<query.proxy_count; ++i) {
+            const query_proxy* proxy = &query.proxies[i];
+            mat4x4 mvp;
+            mat4x4_mul(mvp, query.vp, (vec4*)proxy->box);
+            sogv_gl_uniform_set(query.program, query.mvp, 1, &mvp[0][0]);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, proxy->obj->queries[proxy->slot]);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            proxy->obj->issued[proxy->slot] = query.frame;
+        }
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        sogv_gl_set_enabled(GL_CULL_FACE, cull);
+        sogv_gl_set_enabled(GL_DEPTH_TEST, depth);
+    }
+    query.stats.proxies = query.proxy_count;
+    query.proxy_count = 0;
+    query.last = query.stats;
+}
+
+sogv_query_stats sogv_query_last_stats() {
+    return query.last;
+}
+
+void sogv_query_object_free(sogv_query_object* obj) {
+    if(obj->queries[0]) glDeleteQueries(SOGV_QUERY_SLOTS, obj->queries);
+    memset(obj, 0, sizeof(*obj));
+}
+
+void sogv_query_quit() {
+    if(query.program) {
+        sogv_gl_shader_free(query.program);
+        sogv_gl_delete_vertex_arrays(1, &query.vao);
+        sogv_gl_delete_buffers(1, &query.vbo);
+        sogv_gl_delete_buffers(1, &query.ebo);
+    }
+    free(query.proxies);
+    memset(&query, 0, sizeof(query));
+}
@@ -0,0 +1,334 @@
+#include <sogv.h>
+
+// Render queue: draws are collected during the frame, given a 64-bit key and radix sorted at
+// flush so program, texture and VAO changes happen as rarely as possible. Opaque draws with
+// equal state go front to back.
+//
+// Key, most significant first: program (16) | texture (16) | vao (16) | depth (16).
+// GL names are truncated to 16 bits; a collision only costs an extra state change.
+//
+// Programs that read instance attributes get every run of draws with the same state and index
+// range merged into one instanced draw, so repeated submissions of a model cost one call each.
+// Programs that read SOGV_DRAW_TRANSFORMS instead get every run with the same state cut into
+// multi-draws of distinct base vertices, with the transforms in a buffer texture: a call and
+// an upload per batch however many meshes it holds. Draws left without a partner of another
+// base vertex are drawn one by one with the model uniform.
+
+typedef struct queue_draw {
+    GLuint program;
+    GLuint texture;
+    GLuint vao;
+    GLenum index_type;
+    GLsizei count;
+    size_t offset;
+    GLint base_vertex;
+    mat4x4 transform;
+} queue_draw;
+
+static struct {
+    queue_draw* draws;
+    uint64_t* keys;
+    uint32_t* order;
+    uint32_t* scratch;
+    // multi-draw groups: next draw and end, in sorted positions
+    uint32_t* group_next;
+    uint32_t* group_ends;
+    // one multi-draw's arguments
+    GLsizei* md_counts;
+    const void** md_offsets;
+    GLint* md_bases;
+    size_t count;
+    size_t cap;
+    sogv_queue_stats stats;
+} queue;
+
+// Non-negative floats sort like their bit patterns; the top 16 bits keep sign, exponent and 7
+// mantissa bits, plenty to order draws front to back
+static uint64_t queue_depth_bits(float depth) {
+    if(!(depth > 0.0f)) return 0;
+    union { float f; uint32_t u; } v = { .f = depth };
+    return v.u >> 16;
+}
+
+void sogv_queue_submit(GLuint program, GLuint texture, GLuint vao, GLenum index_type, GLsizei count,
+        size_t offset, GLint base_vertex, mat4x4 transform, float depth) {
+    if(queue.count == queue.cap) {
+        queue.cap = queue.cap ? queue.cap*2 : 256;
+        sogv_arr_resize(queue_draw, queue.draws, queue.cap*sizeof(queue_draw));
+        sogv_arr_resize(uint64_t, queue.keys, queue.cap*sizeof(uint64_t));
+        sogv_arr_resize(uint32_t, queue.order, queue.cap*sizeof(uint32_t));
+        sogv_arr_resize(uint32_t, queue.scratch, queue.cap*sizeof(uint32_t));
+        sogv_arr_resize(uint32_t, queue.group_next, queue.cap*sizeof(uint32_t));
+        sogv_arr_resize(uint32_t, queue.group_ends, queue.cap*sizeof(uint32_t));
+        sogv_arr_resize(GLsizei, queue.md_counts, queue.cap*sizeof(GLsizei));
+        sogv_arr_resize(const void*, queue.md_offsets, queue.cap*sizeof(const void*));
+        sogv_arr_resize(GLint, queue.md_bases, queue.cap*sizeof(GLint));
+    }
+    queue_draw* draw = &queue.draws[queue.count];
+    draw->program = program;
+    draw->texture = texture;
+    draw->vao = vao;
+    draw->index_type = index_type;
+    draw->count = count;
+    draw->offset = offset;
+    draw->base_vertex = base_vertex;
+    mat4x4_dup(draw->transform, transform);
+
+    queue.keys[queue.count] = (uint64_t)(program & 0xffff) << 48 | (uint64_t)(texture & 0xffff) << 32
+                            | (uint64_t)(vao & 0xffff) << 16 | queue_depth_bits(depth);
+    queue.count++;
+}
+
+void sogv_model_submit_lod(const sogv_model* model, size_t level, GLuint program, mat4x4 transform, float depth) {
+    if(!model->ready) return;
+    if(model->vao) {
+        const size_t index_size = model->index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(uint);
+        for(size_t i=0; i<model->mesh_count; ++i) {
+            const sogv_mesh* mesh = &model->meshes[i];
+            const sogv_mesh_lod lod = sogv_mesh_lod_get(mesh, level);
+            sogv_queue_submit(program, model->materials[mesh->mat_idx], model->vao, model->index_type,
+                    lod.indice_count, (mesh->first_index + lod.first_index)*index_size, mesh->base_vertex, transform, depth);
+        }
+        return;
+    }
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        const sogv_mesh* mesh = &model->meshes[i];
+        const sogv_mesh_lod lod = sogv_mesh_lod_get(mesh, level);
+        const size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(uint);
+        sogv_queue_submit(program, model->materials[mesh->mat_idx], mesh->vao, mesh->index_type,
+                lod.indice_count, lod.first_index*index_size, 0, transform, depth);
+    }
+}
+
+void sogv_model_submit(const sogv_model* model, GLuint program, mat4x4 transform, float depth) {
+    sogv_model_submit_lod(model, 0, program, transform, depth);
+}
+
+// LSD radix sort of the draw order, a byte at a time; bytes equal across every key are skipped
+static void queue_sort() {
+    uint64_t same = ~(uint64_t)0;
+    for(size_t i=1; i<queue.count; ++i) same &= ~(queue.keys[i] ^ queue.keys[0]);
+
+    for(uint32_t i=0; i<queue.count; ++i) queue.order[i] = i;
+    uint32_t* src = queue.order;
+    uint32_t* dst = queue.scratch;
+    for(int shift=0; shift<64; shift+=8) {
+        if(((same >> shift) & 0xff) == 0xff) continue;
+        size_t offsets[256] = {0};
+        for(size_t i=0; i<queue.count; ++i) offsets[(queue.keys[src[i]] >> shift) & 0xff]++;
+        size_t sum = 0;
+        for(size_t b=0; b<256; ++b) {
+            size_t n = offsets[b];
+            offsets[b] = sum;
+            sum += n;
+        }
+        for(size_t i=0; i<queue.count; ++i) dst[offsets[(queue.keys[src[i]] >> shift) & 0xff]++] = src[i];
+        uint32_t* t = src;
+        src = dst;
+        dst = t;
+    }
+    if(src != queue.order) memcpy(queue.order, src, queue.count*sizeof(uint32_t));
+}
+
+static bool queue_same_range(const queue_draw* a, const queue_draw* b) {
+    return a->index_type == b->index_type && a->count == b->count && a->offset == b->offset
+        && a->base_vertex == b->base_vertex;
+}
+
+// Positions in the draw order, by index range; ties keep their place, so front to back
+static int queue_range_cmp(const void* a, const void* b) {
+    const uint32_t pa = *(const uint32_t*)a, pb = *(const uint32_t*)b;
+    const queue_draw* da = &queue.draws[queue.order[pa]];
+    const queue_draw* db = &queue.draws[queue.order[pb]];
+    if(da->offset != db->offset) return da->offset < db->offset ? -1 : 1;
+    if(da->count != db->count) return da->count < db->count ? -1 : 1;
+    if(da->base_vertex != db->base_vertex) return da->base_vertex < db->base_vertex ? -1 : 1;
+    if(da->index_type != db->index_type) return da->index_type < db->index_type ? -1 : 1;
+    return (pa > pb) - (pa < pb);
+}
+
+// Draws [first, end) share program, texture and VAO. Sorted by index range, equal ranges are
+// neighbours and each becomes one instanced draw.
+static void queue_flush_instanced(size_t first, size_t end) {
+    uint32_t* sorted = queue.scratch;
+    for(size_t i=first; i<end; ++i) sorted[i-first] = i;
+    qsort(sorted, end-first, sizeof(uint32_t), queue_range_cmp);
+
+    for(size_t a=0; a<end-first; ) {
+        const queue_draw* lead = &queue.draws[queue.order[sorted[a]]];
+        size_t n = 1;
+        while(a+n < end-first && queue_same_range(lead, &queue.draws[queue.order[sorted[a+n]]])) n++;
+        sogv_instance_data* data = sogv_instance_scratch(n);
+        for(size_t i=0; i<n; ++i)
+            sogv_instance_fill(&data[i], (vec4*)queue.draws[queue.order[sorted[a+i]]].transform);
+        a += n;
+        sogv_instance_upload(data, n);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lead->count, lead->index_type,
+                (const void*)lead->offset, n, lead->base_vertex);
+        queue.stats.calls++;
+        queue.stats.transforms += n;
+    }
+}
+
+// Uniforms of the program being flushed, and the transform they hold (NULL if unknown)
+typedef struct queue_program {
+    GLuint program;
+    sogv_uniform model_u;
+    sogv_uniform normal_u;
+    const float* transform;
+} queue_program;
+
+static void queue_draw_single(queue_program* prog, const queue_draw* draw) {
+    if(!prog->transform || memcmp(prog->transform, draw->transform, sizeof(mat4x4)) != 0) {
+        prog->transform = &draw->transform[0][0];
+        sogv_gl_uniform_set(prog->program, prog->model_u, 1, prog->transform);
+        if(prog->normal_u > -1) {
+            mat4x4 normal_mat;
+            mat4x4_invert(normal_mat, draw->transform);
+            mat4x4_transpose(normal_mat, normal_mat);
+            sogv_gl_uniform_set(prog->program, prog->normal_u, 1, &normal_mat[0][0]);
+        }
+        queue.stats.transforms++;
+    }
+
+    if(draw->base_vertex)
+        glDrawElementsBaseVertex(GL_TRIANGLES, draw->count, draw->index_type,
+                (const void*)draw->offset, draw->base_vertex);
+    else
+        glDrawElements(GL_TRIANGLES, draw->count, draw->index_type, (const void*)draw->offset);
+    queue.stats.calls++;
+}
+
+// Positions in the draw order, by index type and base vertex; ties keep their place
+static int queue_base_cmp(const void* a, const void* b) {
+    const uint32_t pa = *(const uint32_t*)a, pb = *(const uint32_t*)b;
+    const queue_draw* da = &queue.draws[queue.order[pa]];
+    const queue_draw* db = &queue.draws[queue.order[pb]];
+    if(da->index_type != db->index_type) return da->index_type < db->index_type ? -1 : 1;
+    if(da->base_vertex != db->base_vertex) return da->base_vertex < db->base_vertex ? -1 : 1;
+    return (pa > pb) - (pa < pb);
+}
+
+// Draws [first, end) share program, texture and VAO. Sorted by base vertex, the draws of one
+// base vertex form a group and pass p takes the p-th draw of every group that long, so a pass
+// is ascending and its vertex ranges disjoint. A pass of one draw goes the plain way.
+static void queue_flush_multidraw(queue_program* prog, size_t first, size_t end) {
+    const size_t n = end - first;
+    uint32_t* sorted = queue.scratch;
+    for(size_t i=first; i<end; ++i) sorted[i-first] = i;
+    qsort(sorted, n, sizeof(uint32_t), queue_base_cmp);
+
+    for(size_t a=0; a<n; ) {
+        // one index type at a time; groups are (next draw, end) pairs, ascending
+        const GLenum index_type = queue.draws[queue.order[sorted[a]]].index_type;
+        size_t groups = 0, b = a;
+        for(; b<n; ++b) {
+            const queue_draw* draw = &queue.draws[queue.order[sorted[b]]];
+            if(draw->index_type != index_type) break;
+            if(b == a || draw->base_vertex != queue.draws[queue.order[sorted[b-1]]].base_vertex) {
+                if(groups) queue.group_ends[groups-1] = b;
+                queue.group_next[groups++] = b;
+            }
+        }
+        queue.group_ends[groups-1] = b;
+        a = b;
+
+        while(groups) {
+            if(groups == 1) {
+                // the rest share a base vertex
+                sogv_gl_uniform_set_by_name(prog->program, SOGV_DRAW_COUNT, 1, (int[]){0});
+                for(size_t i=queue.group_next[0]; i<queue.group_ends[0]; ++i)
+                    queue_draw_single(prog, &queue.draws[queue.order[sorted[i]]]);
+                break;
+            }
+            sogv_instance_data* data = sogv_instance_scratch(groups);
+            size_t live = 0;
+            for(size_t g=0; g<groups; ++g) {
+                const queue_draw* draw = &queue.draws[queue.order[sorted[queue.group_next[g]]]];
+                queue.md_counts[g] = draw->count;
+                queue.md_offsets[g] = (const void*)draw->offset;
+                queue.md_bases[g] = draw->base_vertex;
+                sogv_instance_fill(&data[g], (vec4*)draw->transform);
+                if(++queue.group_next[g] < queue.group_ends[g]) {
+                    queue.group_next[live] = queue.group_next[g];
+                    queue.group_ends[live] = queue.group_ends[g];
+                    live++;
+                }
+            }
+            sogv_multidraw_upload(prog->program, data, queue.md_bases, groups);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, queue.md_counts, index_type, queue.md_offsets, groups, queue.md_bases);
+            queue.stats.calls++;
+            queue.stats.transforms += groups;
+            groups = live;
+        }
+    }
+}
+
+void sogv_queue_flush() {
+    memset(&queue.stats, 0, sizeof(queue.stats));
+    if(!queue.count) return;
+    queue_sort();
+
+    queue_program prog = {0};
+    GLuint texture = 0, vao = 0;
+    bool instanced = false, multidraw = false;
+    bool first = true;
+    for(size_t i=0; i<queue.count; ++i) {
+        const queue_draw* draw = &queue.draws[queue.order[i]];
+        if(first || draw->program != prog.program) {
+            prog.program = draw->program;
+            sogv_gl_use_program(prog.program);
+            prog.model_u = sogv_gl_uniform_find(prog.program, "model");
+            prog.normal_u = sogv_gl_uniform_find(prog.program, "normal_mat");
+            prog.transform = NULL;
+            instanced = sogv_gl_program_instanced(prog.program);
+            multidraw = sogv_gl_program_multidraw(prog.program);
+            queue.stats.programs++;
+        }
+        if(first || draw->texture != texture) {
+            texture = draw->texture;
+            sogv_gl_bind_texture(0, texture);
+            queue.stats.textures++;
+        }
+        if(first || draw->vao != vao) {
+            vao = draw->vao;
+            sogv_gl_bind_vao(vao);
+            queue.stats.vaos++;
+        }
+        first = false;
+
+        if(instanced || multidraw) {
+            size_t end = i+1;
+            while(end < queue.count) {
+                const queue_draw* next = &queue.draws[queue.order[end]];
+                if(next->program != prog.program || next->texture != texture || next->vao != vao) break;
+                end++;
+            }
+            if(multidraw) queue_flush_multidraw(&prog, i, end);
+            else queue_flush_instanced(i, end);
+            i = end-1;
+            continue;
+        }
+        queue_draw_single(&prog, draw);
+    }
+
+    queue.stats.draws = queue.count;
+    queue.count = 0;
+}
+
+sogv_queue_stats sogv_queue_last_stats() {
+    return queue.stats;
+}
+
+void sogv_queue_free() {
+    free(queue.draws);
+    free(queue.keys);
+    free(queue.order);
+    free(queue.scratch);
+    free(queue.group_next);
+    free(queue.group_ends);
+    free(queue.md_counts);
+    free(queue.md_offsets);
+    free(queue.md_bases);
+    memset(&queue, 0, sizeof(queue));
+}
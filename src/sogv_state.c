@@ -0,0 +1,207 @@
+#include <sogv.h>
+
+// Shadow copy of the GL state sogv touches most: program, VAO, 2D and buffer texture per
+// unit, a few buffer targets and the depth/cull/blend enables. Binds that would not change
+// anything are skipped. Everything starts unknown so the first call of each kind always reaches GL.
+//
+// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO, so it is passed through, never shadowed.
+
+#define STATE_UNKNOWN 0xFFFFFFFFu
+#define STATE_TEXTURE_UNITS 16
+#define STATE_UNIFORM_BINDINGS 16
+
+enum {
+    STATE_BUF_ARRAY,
+    STATE_BUF_COPY_WRITE,
+    STATE_BUF_PIXEL_UNPACK,
+    STATE_BUF_UNIFORM,
+    STATE_BUF_TEXTURE,
+    STATE_BUF_COUNT
+};
+
+enum {
+    STATE_CAP_DEPTH_TEST,
+    STATE_CAP_CULL_FACE,
+    STATE_CAP_BLEND,
+    STATE_CAP_COUNT
+};
+
+static struct {
+    bool ready;
+    GLuint program;
+    GLuint vao;
+    GLuint active_unit;
+    GLuint textures[STATE_TEXTURE_UNITS];
+    GLuint buffer_textures[STATE_TEXTURE_UNITS];
+    GLuint buffers[STATE_BUF_COUNT];
+    struct { GLuint buffer; GLintptr offset; GLsizeiptr size; } ranges[STATE_UNIFORM_BINDINGS];
+    // 0 off, 1 on, STATE_UNKNOWN
+    GLuint caps[STATE_CAP_COUNT];
+    sogv_gl_state_stats stats;
+} state;
+
+void sogv_gl_state_reset() {
+    state.program = STATE_UNKNOWN;
+    state.vao = STATE_UNKNOWN;
+    state.active_unit = STATE_UNKNOWN;
+    for(size_t i=0; i<STATE_TEXTURE_UNITS; ++i) state.textures[i] = STATE_UNKNOWN;
+    for(size_t i=0; i<STATE_TEXTURE_UNITS; ++i) state.buffer_textures[i] = STATE_UNKNOWN;
+    for(size_t i=0; i<STATE_BUF_COUNT; ++i) state.buffers[i] = STATE_UNKNOWN;
+    for(size_t i=0; i<STATE_UNIFORM_BINDINGS; ++i) state.ranges[i].buffer = STATE_UNKNOWN;
+    for(size_t i=0; i<STATE_CAP_COUNT; ++i) state.caps[i] = STATE_UNKNOWN;
+    state.ready = true;
+}
+
+// Returns true if the shadow value changed and the GL call has to go out
+static bool state_set(GLuint* shadow, GLuint value) {
+    if(!state.ready) sogv_gl_state_reset();
+    if(*shadow == value) {
+        state.stats.skipped++;
+        return false;
+    }
+    *shadow = value;
+    state.stats.issued++;
+    return true;
+}
+
+static int state_buffer_slot(GLenum target) {
+    switch(target) {
+        case GL_ARRAY_BUFFER: return STATE_BUF_ARRAY;
+        case GL_COPY_WRITE_BUFFER: return STATE_BUF_COPY_WRITE;
+        case GL_PIXEL_UNPACK_BUFFER: return STATE_BUF_PIXEL_UNPACK;
+        case GL_UNIFORM_BUFFER: return STATE_BUF_UNIFORM;
+        case GL_TEXTURE_BUFFER: return STATE_BUF_TEXTURE;
+        default: return -1;
+    }
+}
+
+static int state_cap_slot(GLenum cap) {
+    switch(cap) {
+        case GL_DEPTH_TEST: return STATE_CAP_DEPTH_TEST;
+        case GL_CULL_FACE: return STATE_CAP_CULL_FACE;
+        case GL_BLEND: return STATE_CAP_BLEND;
+        default: return -1;
+    }
+}
+
+void sogv_gl_use_program(GLuint program) {
+    if(!state_set(&state.program, program)) return;
+    // first use of a submitted program
+    sogv_gl_shader_finish(program);
+    glUseProgram(program);
+}
+
+void sogv_gl_bind_vao(GLuint vao) {
+    if(state_set(&state.vao, vao)) glBindVertexArray(vao);
+}
+
+static void state_bind_texture(GLuint* shadow, GLuint unit, GLenum target, GLuint texture) {
+    if(unit >= STATE_TEXTURE_UNITS) sogv_die_v("Texture unit %u out of range", unit);
+    if(!state.ready) sogv_gl_state_reset();
+    if(shadow[unit] == texture) {
+        state.stats.skipped++;
+        return;
+    }
+    if(state.active_unit != unit) {
+        state.active_unit = unit;
+        state.stats.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    shadow[unit] = texture;
+    state.stats.issued++;
+    glBindTexture(target, texture);
+}
+
+void sogv_gl_bind_texture(GLuint unit, GLuint texture) {
+    state_bind_texture(state.textures, unit, GL_TEXTURE_2D, texture);
+}
+
+void sogv_gl_bind_texture_buffer(GLuint unit, GLuint texture) {
+    state_bind_texture(state.buffer_textures, unit, GL_TEXTURE_BUFFER, texture);
+}
+
+void sogv_gl_bind_buffer(GLenum target, GLuint buffer) {
+    int slot = state_buffer_slot(target);
+    if(slot < 0) {
+        state.stats.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if(state_set(&state.buffers[slot], buffer)) glBindBuffer(target, buffer);
+}
+
+// Indexed uniform buffer binds; like GL, these also bind the buffer to GL_UNIFORM_BUFFER
+void sogv_gl_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    if(!state.ready) sogv_gl_state_reset();
+    if(target != GL_UNIFORM_BUFFER || index >= STATE_UNIFORM_BINDINGS) {
+        state.stats.issued++;
+        glBindBufferRange(target, index, buffer, offset, size);
+        return;
+    }
+    if(state.ranges[index].buffer == buffer && state.ranges[index].offset == offset
+            && state.ranges[index].size == size) {
+        state.stats.skipped++;
+        return;
+    }
+    state.ranges[index].buffer = buffer;
+    state.ranges[index].offset = offset;
+    state.ranges[index].size = size;
+    state.buffers[STATE_BUF_UNIFORM] = buffer;
+    state.stats.issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void sogv_gl_set_enabled(GLenum cap, bool enabled) {
+    int slot = state_cap_slot(cap);
+    if(slot < 0) {
+        state.stats.issued++;
+        if(enabled) glEnable(cap);
+        else glDisable(cap);
+        return;
+    }
+    if(state_set(&state.caps[slot], enabled)) {
+        if(enabled) glEnable(cap);
+        else glDisable(cap);
+    }
+}
+
+bool sogv_gl_enabled(GLenum cap) {
+    int slot = state_cap_slot(cap);
+    if(slot < 0) return glIsEnabled(cap);
+    if(!state.ready) sogv_gl_state_reset();
+    if(state.caps[slot] == STATE_UNKNOWN) state.caps[slot] = glIsEnabled(cap) ? 1 : 0;
+    return state.caps[slot] == 1;
+}
+
+// GL unbinds deleted objects from the current context; the names may come back from glGen*
+void sogv_gl_delete_vertex_arrays(GLsizei n, const GLuint* vaos) {
+    for(GLsizei i=0; i<n; ++i)
+        if(vaos[i] && state.vao == vaos[i]) state.vao = 0;
+    glDeleteVertexArrays(n, vaos);
+}
+
+void sogv_gl_delete_buffers(GLsizei n, const GLuint* buffers) {
+    for(GLsizei i=0; i<n; ++i)
+        for(size_t s=0; s<STATE_BUF_COUNT; ++s)
+            if(buffers[i] && state.buffers[s] == buffers[i]) state.buffers[s] = 0;
+    for(GLsizei i=0; i<n; ++i)
+        for(size_t b=0; b<STATE_UNIFORM_BINDINGS; ++b)
+            if(buffers[i] && state.ranges[b].buffer == buffers[i]) state.ranges[b].buffer = 0;
+    glDeleteBuffers(n, buffers);
+}
+
+void sogv_gl_delete_textures(GLsizei n, const GLuint* textures) {
+    for(GLsizei i=0; i<n; ++i)
+        for(size_t u=0; u<STATE_TEXTURE_UNITS; ++u)
+            if(textures[i] && state.textures[u] == textures[i]) state.textures[u] = 0;
+    for(GLsizei i=0; i<n; ++i)
+        for(size_t u=0; u<STATE_TEXTURE_UNITS; ++u)
+            if(textures[i] && state.buffer_textures[u] == textures[i]) state.buffer_textures[u] = 0;
+    glDeleteTextures(n, textures);
+}
+
+sogv_gl_state_stats sogv_gl_state_stats_take() {
+    sogv_gl_state_stats stats = state.stats;
+    memset(&state.stats, 0, sizeof(state.stats));
+    return stats;
+}
@@ -0,0 +1,163 @@
+#include <sogv.h>
+
+// Streaming ring for per-frame data (uniform blocks, bone palettes, multi-draw transforms): one
+// buffer cut into a segment per frame in flight, bump allocated and guarded by a fence per
+// segment. With ARB_buffer_storage the buffer is mapped once, persistent and coherent, and
+// allocations are plain pointers into it. Plain GL 3.3 cannot draw from a mapped buffer, so the
+// allocations between two flushes share one unsynchronized, explicitly flushed mapping of the
+// rest of the segment; and rather than wait for a segment the GPU still reads, the buffer is
+// orphaned and the ring carries on in fresh storage.
+
+#ifndef GL_MAP_PERSISTENT_BIT
+    #define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+    #define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP stream_buffer_storage_fn)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Segments start on this boundary, enough for any offset alignment GL asks for
+#define STREAM_SEGMENT_ALIGN 256
+
+static struct {
+    GLuint buffer;
+    GLsync* fences;
+    size_t segment_size;
+    size_t segment_count;
+    size_t segment;
+    size_t used;
+    // persistent: the whole buffer; otherwise the open mapping, which starts at map_start
+    unsigned char* mapped;
+    size_t map_start;
+    bool persistent;
+    bool active;
+} stream;
+
+static bool stream_storage_create(size_t total) {
+    if(!SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) return false;
+    stream_buffer_storage_fn buffer_storage = (stream_buffer_storage_fn)SDL_GL_GetProcAddress("glBufferStorage");
+    if(!buffer_storage) return false;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    buffer_storage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+    stream.mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+    if(stream.mapped) return true;
+
+    // immutable storage cannot be respecified, so start over with a new buffer
+    sogv_gl_check("mapping stream ring");
+    sogv_gl_delete_buffers(1, &stream.buffer);
+    glGenBuffers(1, &stream.buffer);
+    sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+    return false;
+}
+
+void sogv_stream_init(size_t bytes_per_frame, size_t frames) {
+    if(stream.active) return;
+    stream.segment_size = (bytes_per_frame + STREAM_SEGMENT_ALIGN-1) / STREAM_SEGMENT_ALIGN * STREAM_SEGMENT_ALIGN;
+    stream.segment_count = frames ? frames : 1;
+    stream.segment = 0;
+    stream.used = 0;
+    stream.fences = calloc(stream.segment_count, sizeof(GLsync));
+    if(!stream.fences) sogv_die("Could not allocate stream ring");
+
+    const size_t total = stream.segment_size*stream.segment_count;
+    glGenBuffers(1, &stream.buffer);
+    sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+    stream.persistent = stream_storage_create(total);
+    if(!stream.persistent) glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_DRAW);
+    sogv_gl_check("creating stream ring");
+    sogv_log_v("Stream ring: %zu x %zu bytes, %s", stream.segment_count, stream.segment_size,
+            stream.persistent ? "persistent mapping" : "unsynchronized mapping");
+    stream.active = true;
+}
+
+void sogv_stream_quit() {
+    if(!stream.active) return;
+    sogv_stream_flush();
+    for(size_t i=0; i<stream.segment_count; ++i)
+        if(stream.fences[i]) glDeleteSync(stream.fences[i]);
+    if(stream.persistent) {
+        sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    sogv_gl_delete_buffers(1, &stream.buffer);
+    free(stream.fences);
+    memset(&stream, 0, sizeof(stream));
+}
+
+bool sogv_stream_active() {
+    return stream.active;
+}
+
+void sogv_stream_frame_begin() {
+    if(!stream.active) return;
+    GLsync fence = stream.fences[stream.segment];
+    stream.used = 0;
+    if(!fence) return;
+
+    if(stream.persistent) {
+        // only blocks if the GPU is a whole ring behind
+        if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX) == GL_WAIT_FAILED)
+            sogv_gl_check("waiting for stream ring segment");
+        glDeleteSync(fence);
+        stream.fences[stream.segment] = NULL;
+        return;
+    }
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if(status == GL_TIMEOUT_EXPIRED) {
+        // still in use: orphan the storage, which frees every segment at once
+        sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, stream.segment_size*stream.segment_count, NULL, GL_STREAM_DRAW);
+        for(size_t i=0; i<stream.segment_count; ++i) {
+            if(stream.fences[i]) glDeleteSync(stream.fences[i]);
+            stream.fences[i] = NULL;
+        }
+        return;
+    }
+    if(status == GL_WAIT_FAILED) sogv_gl_check("polling stream ring segment");
+    glDeleteSync(fence);
+    stream.fences[stream.segment] = NULL;
+}
+
+void sogv_stream_frame_end() {
+    if(!stream.active) return;
+    sogv_stream_flush();
+    stream.fences[stream.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream.segment = (stream.segment+1) % stream.segment_count;
+    stream.used = 0;
+}
+
+sogv_stream_block sogv_stream_alloc(size_t size, size_t align) {
+    if(!stream.active) sogv_die("sogv_stream_init was not called");
+    if(!align) align = 1;
+    const size_t base = stream.segment*stream.segment_size;
+    const size_t offset = (base + stream.used + align-1) / align * align;
+    if(offset + size > base + stream.segment_size)
+        sogv_die_v("Stream ring segment full (%zu bytes); raise bytes_per_frame", stream.segment_size);
+
+    if(!stream.persistent && !stream.mapped) {
+        stream.map_start = offset;
+        sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+        stream.mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, base + stream.segment_size - offset,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+        if(!stream.mapped) {
+            sogv_gl_check("mapping stream ring");
+            sogv_die("Could not map stream ring");
+        }
+    }
+    stream.used = offset + size - base;
+    return (sogv_stream_block){
+        .ptr = stream.mapped + (stream.persistent ? offset : offset - stream.map_start),
+        .buffer = stream.buffer,
+        .offset = offset,
+        .size = size,
+    };
+}
+
+void sogv_stream_flush() {
+    if(!stream.active || stream.persistent || !stream.mapped) return;
+    sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+    glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, stream.segment*stream.segment_size + stream.used - stream.map_start);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    stream.mapped = NULL;
+}
@@ -0,0 +1,156 @@
+#include <sogv.h>
+
+typedef struct tex_entry {
+    char* path;
+    GLuint id;
+    size_t refs;
+} tex_entry;
+
+static struct {
+    SDL_SpinLock lock;
+    sogv_name_map by_path;
+    tex_entry* entries;
+    size_t entry_count;
+    size_t entry_cap;
+    int* free_slots;
+    size_t free_count;
+    // GL names are small, so id -> entry is a plain array
+    int* by_id;
+    size_t by_id_cap;
+} cache;
+
+// Lexical clean up so "a/./b", "a//b" and "a/x/../b" share one entry
+static char* tex_path_canonical(const char* path) {
+    size_t len = strlen(path);
+    char* out = malloc(len+1);
+    size_t* starts = malloc((len/2+1)*sizeof(size_t));
+    if(!out || !starts) sogv_die("Could not allocate texture path");
+
+    size_t o = 0, depth = 0;
+    bool absolute = *path == '/';
+    if(absolute) out[o++] = '/';
+    const char* p = path;
+    while(*p) {
+        while(*p == '/') p++;
+        size_t seg = strcspn(p, "/");
+        if(seg == 0 || (seg == 1 && p[0] == '.')) {
+            // nothing
+        } else if(seg == 2 && p[0] == '.' && p[1] == '.'
+                && (depth > 0 ? !(o-starts[depth-1] == 2 && memcmp(out+starts[depth-1], "..", 2) == 0)
+                              : absolute)) {
+            if(depth > 0) {
+                o = starts[--depth];
+                if(o > (absolute ? 1u : 0u)) o--;
+            }
+        } else {
+            if(o > (absolute ? 1u : 0u)) out[o++] = '/';
+            starts[depth++] = o;
+            memcpy(out+o, p, seg);
+            o += seg;
+            out[o] = '\0';
+        }
+        p += seg;
+    }
+    out[o] = '\0';
+    free(starts);
+    return out;
+}
+
+static int tex_find(const char* canonical) {
+    if(!cache.by_path.cap) return -1;
+    return sogv_name_map_get(&cache.by_path, canonical);
+}
+
+bool sogv_tex_cached(const char* path) {
+    char* canonical = tex_path_canonical(path);
+    SDL_AtomicLock(&cache.lock);
+    bool found = tex_find(canonical) > -1;
+    SDL_AtomicUnlock(&cache.lock);
+    free(canonical);
+    return found;
+}
+
+GLuint sogv_tex_ref(const char* path) {
+    char* canonical = tex_path_canonical(path);
+    GLuint id = 0;
+    SDL_AtomicLock(&cache.lock);
+    int idx = tex_find(canonical);
+    if(idx > -1) {
+        cache.entries[idx].refs++;
+        id = cache.entries[idx].id;
+    }
+    SDL_AtomicUnlock(&cache.lock);
+    free(canonical);
+    return id;
+}
+
+void sogv_tex_insert(const char* path, GLuint id) {
+    char* canonical = tex_path_canonical(path);
+    SDL_AtomicLock(&cache.lock);
+    if(!cache.by_path.cap) sogv_name_map_init(&cache.by_path, 64);
+
+    int idx;
+    if(cache.free_count) idx = cache.free_slots[--cache.free_count];
+    else {
+        if(cache.entry_count == cache.entry_cap) {
+            cache.entry_cap = cache.entry_cap ? cache.entry_cap*2 : 64;
+            sogv_arr_resize(tex_entry, cache.entries, cache.entry_cap*sizeof(tex_entry));
+            sogv_arr_resize(int, cache.free_slots, cache.entry_cap*sizeof(int));
+        }
+        idx = cache.entry_count++;
+    }
+    cache.entries[idx] = (tex_entry){ .path = canonical, .id = id, .refs = 1 };
+    if(!sogv_name_map_add(&cache.by_path, canonical, idx))
+        sogv_log_v("Texture %s is already cached, keeping both", canonical);
+
+    if(id >= cache.by_id_cap) {
+        size_t cap = cache.by_id_cap ? cache.by_id_cap : 256;
+        while(cap <= id) cap *= 2;
+        sogv_arr_resize(int, cache.by_id, cap*sizeof(int));
+        for(size_t i=cache.by_id_cap; i<cap; ++i) cache.by_id[i] = -1;
+        cache.by_id_cap = cap;
+    }
+    cache.by_id[id] = idx;
+    SDL_AtomicUnlock(&cache.lock);
+}
+
+GLuint sogv_tex_acquire(const char* path, bool flip) {
+    GLuint id = sogv_tex_ref(path);
+    if(!id) {
+        id = sogv_gl_stb_texture_create(path, flip);
+        sogv_tex_insert(path, id);
+    }
+    return id;
+}
+
+GLuint sogv_tex_acquire_image(const char* path, sogv_image* img, bool flip) {
+    GLuint id = sogv_tex_ref(path);
+    if(!id && img->data) {
+        id = sogv_gl_image_texture_create(img);
+        sogv_tex_insert(path, id);
+    } else if(!id) id = sogv_tex_acquire(path, flip);
+    sogv_image_free(img);
+    return id;
+}
+
+void sogv_tex_release(GLuint id) {
+    if(!id) return;
+    SDL_AtomicLock(&cache.lock);
+    int idx = id < cache.by_id_cap ? cache.by_id[id] : -1;
+    if(idx > -1 && --cache.entries[idx].refs > 0) {
+        SDL_AtomicUnlock(&cache.lock);
+        return;
+    }
+    if(idx > -1) {
+        tex_entry* entry = &cache.entries[idx];
+        if(sogv_name_map_get(&cache.by_path, entry->path) == idx)
+            sogv_name_map_remove(&cache.by_path, entry->path);
+        free(entry->path);
+        entry->path = NULL;
+        cache.by_id[id] = -1;
+        cache.free_slots[cache.free_count++] = idx;
+    }
+    SDL_AtomicUnlock(&cache.lock);
+    // textures the cache never saw are simply deleted
+    sogv_gl_delete_textures(1, &id);
+}
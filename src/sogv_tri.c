@@ -101,53 +101,302 @@ static void sogv_assimp_mat4x4(mat4x4 mat, struct aiMatrix4x4 ai_mat) {
     mat[3][3] = ai_mat.d4;
 }
 
-static void sogv_mesh_glize(sogv_mesh* mesh) {
+static uint16_t sogv_half_from_float(float f) {
+    union { float f; uint32_t u; } v = { .f = f };
+    uint32_t sign = (v.u >> 16) & 0x8000;
+    int32_t exp = ((v.u >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = v.u & 0x7fffff;
+
+    if(((v.u >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0);
+    if(exp >= 31) return sign | 0x7c00;
+    if(exp <= 0) {
+        // subnormal half or zero
+        if(exp < -10) return sign;
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        if((mant >> (shift-1)) & 1) half++;
+        return sign | half;
+    }
+    uint32_t half = sign | (exp << 10) | (mant >> 13);
+    // round to nearest; a carry into the exponent is still the right value
+    if(mant & 0x1000) half++;
+    return half;
+}
+
+static uint32_t sogv_snorm10(float f) {
+    if(f > 1.0f) f = 1.0f;
+    if(f < -1.0f) f = -1.0f;
+    return (uint32_t)(int32_t)lroundf(f * 511.0f) & 0x3ff;
+}
+
+void sogv_mesh_pack(sogv_mesh* mesh) {
+    free(mesh->packed);
+    mesh->packed = malloc(mesh->vert_count * sizeof(sogv_vert_packed));
+    if(!mesh->packed) sogv_die("Could not allocate packed vertices");
+
+    for(size_t i=0; i<mesh->vert_count; ++i) {
+        const sogv_vert* v = &mesh->verts[i];
+        sogv_vert_packed* p = &mesh->packed[i];
+        vec3_dup(p->pos, v->pos);
+        p->normal = sogv_snorm10(v->normal[0]) | sogv_snorm10(v->normal[1]) << 10
+                    | sogv_snorm10(v->normal[2]) << 20;
+        p->uv[0] = sogv_half_from_float(v->uv[0]);
+        p->uv[1] = sogv_half_from_float(v->uv[1]);
+
+        // renormalize to sum 1, then hand the rounding error to the heaviest influence
+        float sum = 0.0f;
+        for(size_t k=0; k<MAX_BONE_INFLUENCE; ++k) sum += v->weights[k];
+        int total = 0;
+        size_t heaviest = 0;
+        for(size_t k=0; k<MAX_BONE_INFLUENCE; ++k) {
+            p->bone_ids[k] = (uint8_t)v->bone_info[k];
+            p->weights[k] = sum > 0.0f ? (uint8_t)lroundf(v->weights[k] / sum * 255.0f) : 0;
+            total += p->weights[k];
+            if(v->weights[k] > v->weights[heaviest]) heaviest = k;
+        }
+        if(sum > 0.0f) p->weights[heaviest] += 255 - total;
+    }
+}
+
+void sogv_mesh_index_narrow(sogv_mesh* mesh) {
+    free(mesh->short_indices);
+    mesh->short_indices = NULL;
+    mesh->index_type = GL_UNSIGNED_INT;
+    if(mesh->vert_count > 65536) return;
+
+    const size_t total = sogv_mesh_index_total(mesh);
+    mesh->short_indices = malloc(total * sizeof(unsigned short));
+    if(!mesh->short_indices) sogv_die("Could not allocate 16-bit indices");
+    for(size_t i=0; i<total; ++i)
+        mesh->short_indices[i] = mesh->indices[i];
+    mesh->index_type = GL_UNSIGNED_SHORT;
+}
+
+void sogv_mesh_bounds(sogv_mesh* mesh) {
+    vec3_dup(mesh->min, (vec3){INFINITY, INFINITY, INFINITY});
+    vec3_dup(mesh->max, (vec3){-INFINITY, -INFINITY, -INFINITY});
+    for(size_t i=0; i<mesh->vert_count; ++i) {
+        vec3_min(mesh->min, mesh->min, mesh->verts[i].pos);
+        vec3_max(mesh->max, mesh->max, mesh->verts[i].pos);
+    }
+    if(!mesh->vert_count) {
+        vec3_dup(mesh->min, (vec3){0.0f, 0.0f, 0.0f});
+        vec3_dup(mesh->max, (vec3){0.0f, 0.0f, 0.0f});
+    }
+    vec3_add(mesh->center, mesh->min, mesh->max);
+    vec3_scale(mesh->center, mesh->center, 0.5f);
+
+    float r2 = 0.0f;
+    for(size_t i=0; i<mesh->vert_count; ++i) {
+        vec3 d;
+        vec3_sub(d, mesh->verts[i].pos, mesh->center);
+        float l2 = vec3_mul_inner(d, d);
+        if(l2 > r2) r2 = l2;
+    }
+    mesh->radius = sqrtf(r2);
+}
+
+void sogv_model_bounds(sogv_model* model) {
+    vec3_dup(model->min, (vec3){0.0f, 0.0f, 0.0f});
+    vec3_dup(model->max, (vec3){0.0f, 0.0f, 0.0f});
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        const sogv_mesh* mesh = &model->meshes[i];
+        if(i == 0) {
+            vec3_dup(model->min, mesh->min);
+            vec3_dup(model->max, mesh->max);
+        }
+        vec3_min(model->min, model->min, mesh->min);
+        vec3_max(model->max, model->max, mesh->max);
+    }
+    vec3_add(model->center, model->min, model->max);
+    vec3_scale(model->center, model->center, 0.5f);
+
+    // every mesh sphere must fit, which the box's own circumsphere may overshoot
+    model->radius = 0.0f;
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        const sogv_mesh* mesh = &model->meshes[i];
+        vec3 d;
+        vec3_sub(d, mesh->center, model->center);
+        float r = vec3_len(d) + mesh->radius;
+        if(r > model->radius) model->radius = r;
+    }
+}
+
+static void sogv_vert_attribs(bool packed) {
+    glEnableVertexAttribArray(SOGV_ATTR_POSITION_ID);
+    glEnableVertexAttribArray(SOGV_ATTR_NORMAL_ID);
+    glEnableVertexAttribArray(SOGV_ATTR_UV_ID);
+    glEnableVertexAttribArray(SOGV_ATTR_BONE_ID);
+    glEnableVertexAttribArray(SOGV_ATTR_WEIGHT_ID);
+
+    if(packed) {
+        glVertexAttribPointer(SOGV_ATTR_POSITION_ID, 3, GL_FLOAT, GL_FALSE,
+                sizeof(sogv_vert_packed), (void*)offsetof(sogv_vert_packed, pos));
+        glVertexAttribPointer(SOGV_ATTR_NORMAL_ID, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+                sizeof(sogv_vert_packed), (void*)offsetof(sogv_vert_packed, normal));
+        glVertexAttribPointer(SOGV_ATTR_UV_ID, 2, GL_HALF_FLOAT, GL_FALSE,
+                sizeof(sogv_vert_packed), (void*)offsetof(sogv_vert_packed, uv));
+        glVertexAttribIPointer(SOGV_ATTR_BONE_ID, 4, GL_UNSIGNED_BYTE,
+                sizeof(sogv_vert_packed), (void*)offsetof(sogv_vert_packed, bone_ids));
+        glVertexAttribPointer(SOGV_ATTR_WEIGHT_ID, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                sizeof(sogv_vert_packed), (void*)offsetof(sogv_vert_packed, weights));
+    } else {
+        glVertexAttribPointer(SOGV_ATTR_POSITION_ID, 3, GL_FLOAT, GL_FALSE,
+                sizeof(sogv_vert), (void*)0);
+        glVertexAttribPointer(SOGV_ATTR_NORMAL_ID, 3, GL_FLOAT, GL_FALSE,
+                sizeof(sogv_vert), (void*)offsetof(sogv_vert, normal));
+        glVertexAttribPointer(SOGV_ATTR_UV_ID, 2, GL_FLOAT, GL_FALSE,
+                sizeof(sogv_vert), (void*)offsetof(sogv_vert, uv));
+        glVertexAttribPointer(SOGV_ATTR_BONE_ID, 4, GL_FLOAT, GL_FALSE,
+                sizeof(sogv_vert), (void*)offsetof(sogv_vert, bone_info));
+        glVertexAttribPointer(SOGV_ATTR_WEIGHT_ID, 4, GL_FLOAT, GL_FALSE,
+                sizeof(sogv_vert), (void*)offsetof(sogv_vert, weights));
+    }
+
+    // leaves GL_ARRAY_BUFFER on the instance buffer; fill vertex data before this
+    sogv_instance_attach();
+}
+
+static void sogv_mesh_glize_buffers(sogv_mesh* mesh, bool fill) {
+    const bool packed = mesh->packed != NULL;
+    const GLsizei stride = packed ? sizeof(sogv_vert_packed) : sizeof(sogv_vert);
+    const void* verts = !fill ? NULL : packed ? (const void*)mesh->packed : (const void*)mesh->verts;
+
     glGenVertexArrays(1, &mesh->vao);
     glGenBuffers(1, &mesh->vbo);
     glGenBuffers(1, &mesh->ebo);
 
-    glBindVertexArray(mesh->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-    glBufferData(GL_ARRAY_BUFFER, mesh->vert_count * sizeof(sogv_vert), mesh->verts, GL_STATIC_DRAW);
+    sogv_gl_bind_vao(mesh->vao);
+    sogv_gl_bind_buffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh->vert_count * stride, verts, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indice_count * sizeof(uint), mesh->indices, GL_STATIC_DRAW);
+    const bool narrow = mesh->index_type == GL_UNSIGNED_SHORT;
+    const void* indices = !fill ? NULL : narrow ? (const void*)mesh->short_indices : (const void*)mesh->indices;
+    sogv_gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sogv_mesh_index_total(mesh) * (narrow ? sizeof(unsigned short) : sizeof(uint)),
+            indices, GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(SOGV_ATTR_POSITION_ID);
-    glVertexAttribPointer(SOGV_ATTR_POSITION_ID, 3, GL_FLOAT, GL_FALSE,
-            sizeof(sogv_vert), (void*)0);
+    sogv_vert_attribs(packed);
+    sogv_gl_bind_vao(0);
+}
 
-    glEnableVertexAttribArray(SOGV_ATTR_NORMAL_ID);
-    glVertexAttribPointer(SOGV_ATTR_NORMAL_ID, 3, GL_FLOAT, GL_FALSE,
-            sizeof(sogv_vert), (void*)offsetof(sogv_vert, normal));
+void sogv_mesh_glize(sogv_mesh* mesh) {
+    sogv_mesh_glize_buffers(mesh, true);
+}
 
-    glEnableVertexAttribArray(SOGV_ATTR_UV_ID);
-    glVertexAttribPointer(SOGV_ATTR_UV_ID, 2, GL_FLOAT, GL_FALSE,
-            sizeof(sogv_vert), (void*)offsetof(sogv_vert, uv));
+void sogv_mesh_glize_storage(sogv_mesh* mesh) {
+    sogv_mesh_glize_buffers(mesh, false);
+}
 
-    glEnableVertexAttribArray(SOGV_ATTR_BONE_ID);
-    glVertexAttribPointer(SOGV_ATTR_BONE_ID, 4, GL_FLOAT, GL_FALSE,
-            sizeof(sogv_vert), (void*)offsetof(sogv_vert, bone_info));
+// Vertices go back to back (base_vertex) and so do indices (first_index); the index type is
+// 16-bit only if every mesh narrowed
+static void sogv_model_glize_shared(sogv_model* model, bool fill) {
+    if(!model->mesh_count) return;
+    const bool packed = model->meshes[0].packed != NULL;
+    const size_t stride = packed ? sizeof(sogv_vert_packed) : sizeof(sogv_vert);
+    const bool narrow = model->index_type == GL_UNSIGNED_SHORT;
+    const size_t index_size = narrow ? sizeof(unsigned short) : sizeof(uint);
+    const sogv_mesh* last = &model->meshes[model->mesh_count-1];
+
+    glGenVertexArrays(1, &model->vao);
+    glGenBuffers(1, &model->vbo);
+    glGenBuffers(1, &model->ebo);
+
+    sogv_gl_bind_vao(model->vao);
+    sogv_gl_bind_buffer(GL_ARRAY_BUFFER, model->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (last->base_vertex + last->vert_count) * stride, NULL, GL_STATIC_DRAW);
+    sogv_gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, model->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (last->first_index + sogv_mesh_index_total(last)) * index_size, NULL, GL_STATIC_DRAW);
+
+    for(size_t i=0; fill && i<model->mesh_count; ++i) {
+        const sogv_mesh* mesh = &model->meshes[i];
+        glBufferSubData(GL_ARRAY_BUFFER, mesh->base_vertex * stride, mesh->vert_count * stride,
+                packed ? (const void*)mesh->packed : (const void*)mesh->verts);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, mesh->first_index * index_size, sogv_mesh_index_total(mesh) * index_size,
+                narrow ? (const void*)mesh->short_indices : (const void*)mesh->indices);
+    }
 
-    glEnableVertexAttribArray(SOGV_ATTR_WEIGHT_ID);
-    glVertexAttribPointer(SOGV_ATTR_WEIGHT_ID, 4, GL_FLOAT, GL_FALSE,
-            sizeof(sogv_vert), (void*)offsetof(sogv_vert, weights));
+    sogv_vert_attribs(packed);
+    sogv_gl_bind_vao(0);
+    sogv_gl_check("creating shared model buffers");
+}
+
+void sogv_model_glize_shared_storage(sogv_model* model) {
+    sogv_model_glize_shared(model, false);
+}
+
+static size_t sogv_model_lod_levels(const sogv_model* model) {
+    return model->lod_count ? model->lod_count : 1;
+}
+
+// Lays the meshes out for the shared buffers and groups them by material (CPU only)
+void sogv_model_batch(sogv_model* model) {
+    model->index_type = GL_UNSIGNED_SHORT;
+    size_t base = 0, first = 0;
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        sogv_mesh* mesh = &model->meshes[i];
+        if(mesh->index_type != GL_UNSIGNED_SHORT) model->index_type = GL_UNSIGNED_INT;
+        mesh->base_vertex = base;
+        mesh->first_index = first;
+        base += mesh->vert_count;
+        first += sogv_mesh_index_total(mesh);
+    }
+    const size_t index_size = model->index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(uint);
+    const size_t levels = sogv_model_lod_levels(model);
 
-    glBindVertexArray(0);
+    size_t* mesh_batch = malloc(model->mesh_count * sizeof(size_t));
+    model->batches = calloc(model->mesh_count * levels, sizeof(sogv_draw_batch));
+    if(!mesh_batch || !model->batches) sogv_die("Could not allocate draw batches");
+    model->batch_count = 0;
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        size_t b = 0;
+        while(b < model->batch_count && model->batches[b].mat_idx != model->meshes[i].mat_idx) b++;
+        if(b == model->batch_count) model->batches[model->batch_count++].mat_idx = model->meshes[i].mat_idx;
+        model->batches[b].draw_count++;
+        mesh_batch[i] = b;
+    }
+    // every level draws the same meshes, just fewer indices of each
+    for(size_t b=model->batch_count; b<model->batch_count*levels; ++b)
+        model->batches[b] = model->batches[b % model->batch_count];
+    for(size_t b=0; b<model->batch_count*levels; ++b) {
+        sogv_draw_batch* batch = &model->batches[b];
+        batch->counts = malloc(batch->draw_count * sizeof(GLsizei));
+        batch->offsets = malloc(batch->draw_count * sizeof(void*));
+        batch->base_vertices = malloc(batch->draw_count * sizeof(GLint));
+        if(!batch->counts || !batch->offsets || !batch->base_vertices) sogv_die("Could not allocate draw batches");
+        batch->draw_count = 0;
+    }
+    for(size_t level=0; level<levels; ++level)
+        for(size_t i=0; i<model->mesh_count; ++i) {
+            const sogv_mesh* mesh = &model->meshes[i];
+            const sogv_mesh_lod lod = sogv_mesh_lod_get(mesh, level);
+            sogv_draw_batch* batch = &model->batches[level*model->batch_count + mesh_batch[i]];
+            batch->counts[batch->draw_count] = lod.indice_count;
+            batch->offsets[batch->draw_count] = (const void*)((mesh->first_index + lod.first_index) * index_size);
+            batch->base_vertices[batch->draw_count] = mesh->base_vertex;
+            batch->draw_count++;
+        }
+    free(mesh_batch);
 }
 
-static void sogv_mesh_render(sogv_mesh* mesh) {
-    glBindVertexArray(mesh->vao);
-    glDrawElements(GL_TRIANGLES, mesh->indice_count, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+static void sogv_mesh_render(sogv_mesh* mesh, size_t level) {
+    const sogv_mesh_lod lod = sogv_mesh_lod_get(mesh, level);
+    const size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(uint);
+    sogv_gl_bind_vao(mesh->vao);
+    glDrawElements(GL_TRIANGLES, lod.indice_count, mesh->index_type, (const void*)(lod.first_index * index_size));
 }
 
 static void sogv_mesh_clean(sogv_mesh* mesh) {
     free(mesh->verts);
     free(mesh->indices);
-    glDeleteVertexArrays(1, &mesh->vao);
-    glDeleteBuffers(1, &mesh->vbo);
-    glDeleteBuffers(1, &mesh->ebo);
+    free(mesh->packed);
+    free(mesh->short_indices);
+    // imported but never uploaded meshes have no GL objects (and maybe no context)
+    if(!mesh->vao) return;
+    sogv_gl_delete_vertex_arrays(1, &mesh->vao);
+    sogv_gl_delete_buffers(1, &mesh->vbo);
+    sogv_gl_delete_buffers(1, &mesh->ebo);
 }
 
 static const struct aiScene* sogv_assimp_scene_load(const char* path) {
@@ -161,7 +410,7 @@ static const struct aiScene* sogv_assimp_scene_load(const char* path) {
 }
 
 static int sogv_skel_node_import(const struct aiNode* ai_node, sogv_skel_node** skel_node,
-                        size_t bone_count, char bone_names[][64]) {
+                        const sogv_name_map* bone_map) {
     sogv_skel_node* t_node = calloc(1, sizeof(sogv_skel_node));
     t_node->bone_idx = -1;
     t_node->child_count = 0;
@@ -181,20 +430,19 @@ static int sogv_skel_node_import(const struct aiNode* ai_node, sogv_skel_node**
     for(size_t i=0; i<MAX_BONES; ++i)
         t_node->children[i] = NULL;
 
-    bool has_bone = false;
-    for(size_t i=0; i<bone_count; ++i)
-        if(strcmp(bone_names[i], t_node->name)==0) {
-            sogv_log_v("node will use bone %zu : %s", i, t_node->name);
-            t_node->bone_idx = i;
-            has_bone = true;
-            break;
-        }
-    if(!has_bone) sogv_log("no bones found");
+    t_node->bone_idx = sogv_name_map_get(bone_map, t_node->name);
+    bool has_bone = t_node->bone_idx > -1;
+    if(has_bone) sogv_log_v("node will use bone %d : %s", t_node->bone_idx, t_node->name);
+    else sogv_log("no bones found");
 
     bool has_usable_child = false;
     for(size_t i=0; i<ai_node->mNumChildren; ++i) {
+        if(t_node->child_count == MAX_BONES) {
+            sogv_log_v("node %s has more than %d usable children", t_node->name, MAX_BONES);
+            break;
+        }
         if(sogv_skel_node_import(ai_node->mChildren[i],
-                    &t_node->children[t_node->child_count], bone_count, bone_names)==0) {
+                    &t_node->children[t_node->child_count], bone_map)==0) {
             has_usable_child = true;
             t_node->child_count++;
         } else sogv_log("non-usable child node thrown away");
@@ -209,16 +457,18 @@ static int sogv_skel_node_import(const struct aiNode* ai_node, sogv_skel_node**
     return 1;
 }
 
-static sogv_skel_node* sogv_skel_node_find(sogv_skel_node* root, const char* name) {
-    if(strcmp(name, root->name)==0)
-        return root;
-
-    for(size_t i=0; i<root->child_count; ++i) {
-        sogv_skel_node* child = sogv_skel_node_find(root->children[i], name);
-        if(child) return child;
+// Pre-order, so a name shared by several nodes resolves to the first one like a tree walk would
+static void sogv_skel_node_index(sogv_skel_node* node, sogv_name_map* node_map,
+                        sogv_skel_node*** nodes, size_t* node_count, size_t* node_cap) {
+    if(*node_count == *node_cap) {
+        *node_cap = *node_cap ? *node_cap*2 : 64;
+        sogv_arr_resize(sogv_skel_node*, *nodes, *node_cap*sizeof(sogv_skel_node*));
     }
+    if(sogv_name_map_add(node_map, node->name, *node_count))
+        (*nodes)[(*node_count)++] = node;
 
-    return NULL;
+    for(size_t i=0; i<node->child_count; ++i)
+        sogv_skel_node_index(node->children[i], node_map, nodes, node_count, node_cap);
 }
 
 static void sogv_skel_node_clean(sogv_skel_node* node) {
@@ -232,25 +482,37 @@ static void sogv_skel_node_clean(sogv_skel_node* node) {
         sogv_skel_node_clean(node->children[i]);
 }
 
-sogv_model* sogv_model_create(const char* folder, const char* file) {
-    char* model_path = calloc(strlen(folder)+strlen(file)+1, sizeof(char));
-    strcpy(model_path, folder);
-    strcat(model_path, file);
-    const struct aiScene* scene = sogv_assimp_scene_load(model_path);
-    if(!scene) sogv_die("Could not load assimp scene");
-    free(model_path);
+typedef struct sogv_image_decode {
+    sogv_image* img;
+    const char* path;
+    bool flip;
+    bool ok;
+} sogv_image_decode;
+
+static void sogv_image_decode_work(void* arg) {
+    sogv_image_decode* decode = arg;
+    decode->ok = sogv_image_load(decode->img, decode->path, decode->flip);
+}
 
+// CPU side of sogv_model_create, safe to run on a worker thread (no GL calls)
+static void sogv_model_import_scene_into(sogv_model* _model, const struct aiScene* scene,
+                        const char* folder, uint flags) {
     size_t ai_mesh_count = scene->mNumMeshes;
     size_t ai_mat_count = scene->mNumMaterials;
 
     // Setup the model
-    sogv_model* _model = calloc(1, sizeof(sogv_model));
     _model->meshes = calloc(ai_mesh_count, sizeof(sogv_mesh));
     _model->materials =  calloc(ai_mat_count, sizeof(GLuint));
+    _model->mat_paths = calloc(ai_mat_count, sizeof(char*));
+    _model->mat_images = calloc(ai_mat_count, sizeof(sogv_image));
     _model->mesh_count = ai_mesh_count;
     _model->mat_count = ai_mat_count;
     _model->bone_count = 0;
     _model->root_node = NULL;
+    _model->flags = flags;
+
+    sogv_name_map bone_map;
+    sogv_name_map_init(&bone_map, MAX_BONES);
 
     // Setup the mesh
     for(size_t mesh_idx = 0; mesh_idx < ai_mesh_count; ++mesh_idx) {
@@ -293,55 +555,64 @@ sogv_model* sogv_model_create(const char* folder, const char* file) {
         }
 
         // Setup bones to a model
-        if(ai_bone_count>0) {
-            char bone_names[MAX_BONES][64];
-            // go throught the ai_bone_count and see if we already have the same name inside our model
-            // if we dont have the name: add; if we have - skip.
-            for(size_t i=0; i<ai_bone_count; ++i) {
-                const struct aiBone* ai_bone = ai_mesh->mBones[i];
-                strncpy(bone_names[i], ai_bone->mName.data, 63);
-
-                bool exists = false;
-                for(size_t j=0; j<MAX_BONES; ++j)
-                    if(strcmp(bone_names[i], _model->bone_names[j])==0) {
-                        exists = true;
-                        sogv_log_v("bone %s is already saved", bone_names[i]);
-                }
-
-                if(!exists) {
-                    sogv_assimp_mat4x4(_model->bones[i], ai_bone->mOffsetMatrix);
-                    strncpy(_model->bone_names[i], bone_names[i], 63);
-                    _model->bone_count++;
-                }
+        // bones shared between meshes resolve to the slot of whichever mesh saved them first
+        for(size_t i=0; i<ai_bone_count; ++i) {
+            const struct aiBone* ai_bone = ai_mesh->mBones[i];
+            char bone_name[64] = {0};
+            strncpy(bone_name, ai_bone->mName.data, 63);
+
+            int bone_idx = sogv_name_map_get(&bone_map, bone_name);
+            if(bone_idx > -1) sogv_log_v("bone %s is already saved", bone_name);
+            else if(_model->bone_count < MAX_BONES) {
+                bone_idx = _model->bone_count++;
+                sogv_assimp_mat4x4(_model->bones[bone_idx], ai_bone->mOffsetMatrix);
+                strncpy(_model->bone_names[bone_idx], bone_name, 63);
+                sogv_name_map_add(&bone_map, _model->bone_names[bone_idx], bone_idx);
+            } else {
+                sogv_log_v("bone %s is over the %d bone limit", bone_name, MAX_BONES);
+                continue;
+            }
 
-                // Setup bone weights
-                const size_t ai_weight_count = ai_bone->mNumWeights;
-                for(size_t j=0; j<ai_weight_count; ++j) {
-                    struct aiVertexWeight ai_weight = ai_bone->mWeights[j];
-                    uint v_i = ai_weight.mVertexId;
-                    for(size_t k=0; k<MAX_BONE_INFLUENCE; ++k) {
-                        if(_mesh.verts[v_i].weights[k]==0.0f) {
-                            _mesh.verts[v_i].bone_info[k] = i;
-                            _mesh.verts[v_i].weights[k] = ai_weight.mWeight;
-                            break;
-                        }
+            // Setup bone weights
+            const size_t ai_weight_count = ai_bone->mNumWeights;
+            for(size_t j=0; j<ai_weight_count; ++j) {
+                struct aiVertexWeight ai_weight = ai_bone->mWeights[j];
+                uint v_i = ai_weight.mVertexId;
+                for(size_t k=0; k<MAX_BONE_INFLUENCE; ++k) {
+                    if(_mesh.verts[v_i].weights[k]==0.0f) {
+                        _mesh.verts[v_i].bone_info[k] = bone_idx;
+                        _mesh.verts[v_i].weights[k] = ai_weight.mWeight;
+                        break;
                     }
                 }
             }
         }
 
-        // Copy everything to GL buffers and put into model array
-
-        sogv_mesh_glize(&_mesh);
+        // LODs first, so optimizing reorders their levels along with level 0
+        if(flags & SOGV_MODEL_LODS) sogv_mesh_lods(&_mesh);
+        if(flags & SOGV_MODEL_OPTIMIZE) sogv_mesh_optimize(&_mesh, flags & SOGV_MODEL_OPTIMIZE_OVERDRAW);
+        sogv_mesh_index_narrow(&_mesh);
+        if(flags & SOGV_MODEL_PACKED_VERTS) sogv_mesh_pack(&_mesh);
+        sogv_mesh_bounds(&_mesh);
         _model->meshes[mesh_idx] = _mesh;
     }
+    sogv_model_bounds(_model);
+    sogv_model_lod_errors(_model);
+    if(flags & SOGV_MODEL_SHARED_BUFFERS) sogv_model_batch(_model);
     sogv_log_v("Model bone count: %zu", _model->bone_count);
     for(size_t i=0; i<_model->bone_count; ++i) sogv_log_v("bone %zu : %s", i, _model->bone_names[i]);
 
     // Setup skeleton nodes
     const struct aiNode* ai_node = scene->mRootNode;
-    if(sogv_skel_node_import(ai_node, &_model->root_node, _model->bone_count, _model->bone_names)==1)
+    if(sogv_skel_node_import(ai_node, &_model->root_node, &bone_map)==1)
         sogv_log("No skeleton found inside the model");
+    sogv_name_map_free(&bone_map);
+
+    sogv_name_map node_map;
+    sogv_skel_node** nodes = NULL;
+    size_t node_count = 0, node_cap = 0;
+    sogv_name_map_init(&node_map, 64);
+    if(_model->root_node) sogv_skel_node_index(_model->root_node, &node_map, &nodes, &node_count, &node_cap);
 
     // Setup first animation
     if(scene->mNumAnimations > 0) {
@@ -356,7 +627,12 @@ sogv_model* sogv_model_create(const char* folder, const char* file) {
 
         for(size_t i=0; i<anim->mNumChannels; ++i) {
             const struct aiNodeAnim* channel = anim->mChannels[i];
-            sogv_skel_node* node = sogv_skel_node_find(_model->root_node, channel->mNodeName.data);
+            int node_idx = sogv_name_map_get(&node_map, channel->mNodeName.data);
+            if(node_idx < 0) {
+                sogv_log_v("animation channel %s has no node", channel->mNodeName.data);
+                continue;
+            }
+            sogv_skel_node* node = nodes[node_idx];
             node->pos_keys_count = channel->mNumPositionKeys;
             node->rot_keys_count = channel->mNumRotationKeys;
             node->sca_keys_count = channel->mNumScalingKeys;
@@ -383,7 +659,12 @@ sogv_model* sogv_model_create(const char* folder, const char* file) {
             }
         }
     }
+    sogv_name_map_free(&node_map);
+    free(nodes);
 
+    // Decodes go to the worker pool all at once; this thread helps out while it waits
+    sogv_job_group decodes = {0};
+    sogv_image_decode* jobs = calloc(ai_mat_count, sizeof(sogv_image_decode));
     for(size_t m_idx = 0; m_idx < ai_mat_count; ++m_idx) {
         struct aiString ai_str;
         if(aiGetMaterialTexture(scene->mMaterials[m_idx], aiTextureType_DIFFUSE, 0, &ai_str,
@@ -391,29 +672,209 @@ sogv_model* sogv_model_create(const char* folder, const char* file) {
             char* tex_path = calloc(strlen(folder)+strlen(ai_str.data)+1, sizeof(char));
             strcpy(tex_path, folder);
             strcat(tex_path, ai_str.data);
-            _model->materials[m_idx] = sogv_gl_stb_texture_create(tex_path);
-            free(tex_path);
+            _model->mat_paths[m_idx] = tex_path;
+
+            // shared textures are decoded once, by whichever material or model sees them first
+            bool shared = sogv_tex_cached(tex_path);
+            for(size_t i=0; i<m_idx && !shared; ++i)
+                shared = _model->mat_paths[i] && strcmp(_model->mat_paths[i], tex_path)==0;
+            if(shared) continue;
+
+            jobs[m_idx] = (sogv_image_decode) {
+                .img = &_model->mat_images[m_idx],
+                .path = tex_path,
+                .flip = flags & SOGV_MODEL_FLIP_TEXTURES
+            };
+            sogv_job_push_group(&decodes, sogv_image_decode_work, &jobs[m_idx]);
         }
     }
+    sogv_jobs_wait(&decodes);
+    for(size_t m_idx = 0; m_idx < ai_mat_count; ++m_idx)
+        if(jobs[m_idx].path && !jobs[m_idx].ok)
+            sogv_die_v("STBI could not load image: %s", jobs[m_idx].path);
+    free(jobs);
+}
+
+static void sogv_model_import_into(sogv_model* _model, const char* folder, const char* file, uint flags) {
+    char* model_path = calloc(strlen(folder)+strlen(file)+1, sizeof(char));
+    strcpy(model_path, folder);
+    strcat(model_path, file);
+    const struct aiScene* scene = sogv_assimp_scene_load(model_path);
+    if(!scene) sogv_die("Could not load assimp scene");
+    free(model_path);
 
+    sogv_model_import_scene_into(_model, scene, folder, flags);
     aiReleaseImport(scene);
+}
+
+sogv_model* sogv_model_import(const char* folder, const char* file, uint flags) {
+    sogv_model* _model = calloc(1, sizeof(sogv_model));
+    sogv_model_import_into(_model, folder, file, flags);
+    return _model;
+}
+
+sogv_model* sogv_model_import_scene(const struct aiScene* scene, const char* folder, uint flags) {
+    sogv_model* _model = calloc(1, sizeof(sogv_model));
+    sogv_model_import_scene_into(_model, scene, folder, flags);
+    return _model;
+}
+
+void sogv_model_glize(sogv_model* model) {
+    if(model->batches) sogv_model_glize_shared(model, true);
+    else for(size_t i=0; i<model->mesh_count; ++i)
+        sogv_mesh_glize(&model->meshes[i]);
+}
+
+void sogv_model_upload(sogv_model* model) {
+    // Copy everything to GL buffers
+    sogv_model_glize(model);
+
+    for(size_t i=0; i<model->mat_count; ++i)
+        if(model->mat_paths[i])
+            model->materials[i] = sogv_tex_acquire_image(model->mat_paths[i], &model->mat_images[i],
+                    model->flags & SOGV_MODEL_FLIP_TEXTURES);
+    free(model->mat_images);
+    model->mat_images = NULL;
+    model->ready = true;
+}
+
+sogv_model* sogv_model_create_ex(const char* folder, const char* file, uint flags) {
+    sogv_model* _model = sogv_model_import(folder, file, flags);
+    sogv_model_upload(_model);
     return _model;
 }
 
+sogv_model* sogv_model_create(const char* folder, const char* file) {
+    return sogv_model_create_ex(folder, file, 0);
+}
+
+typedef struct sogv_model_load {
+    sogv_model* model;
+    char* folder;
+    char* file;
+} sogv_model_load;
+
+static void sogv_model_load_work(void* arg) {
+    sogv_model_load* load = arg;
+    sogv_model_import_into(load->model, load->folder, load->file, load->model->flags);
+}
+
+static void sogv_model_load_done(void* arg) {
+    sogv_model_load* load = arg;
+    load->model->loading = false;
+    if(load->model->discarded) sogv_model_free(load->model);
+    else sogv_upload_model(load->model);
+    free(load->folder);
+    free(load->file);
+    free(load);
+}
+
+sogv_model* sogv_model_create_async_ex(const char* folder, const char* file, uint flags) {
+    sogv_model_load* load = malloc(sizeof(sogv_model_load));
+    load->model = calloc(1, sizeof(sogv_model));
+    load->model->loading = true;
+    load->model->flags = flags;
+    load->folder = strdup(folder);
+    load->file = strdup(file);
+    sogv_job_push(sogv_model_load_work, sogv_model_load_done, load);
+    return load->model;
+}
+
+sogv_model* sogv_model_create_async(const char* folder, const char* file) {
+    return sogv_model_create_async_ex(folder, file, 0);
+}
+
+void sogv_model_render_lod(sogv_model* model, size_t level) {
+    if(!model->ready) return;
+    const size_t levels = sogv_model_lod_levels(model);
+    if(level >= levels) level = levels-1;
+    if(model->vao) {
+        sogv_gl_bind_vao(model->vao);
+        for(size_t i=0; i<model->batch_count; ++i) {
+            const sogv_draw_batch* batch = &model->batches[level*model->batch_count + i];
+            sogv_gl_bind_texture(0, model->materials[batch->mat_idx]);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch->counts, model->index_type,
+                    batch->offsets, batch->draw_count, batch->base_vertices);
+        }
+        return;
+    }
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        sogv_gl_bind_texture(0, model->materials[model->meshes[i].mat_idx]);
+        sogv_mesh_render(&model->meshes[i], level);
+    }
+}
+
 void sogv_model_render(sogv_model* model) {
+    sogv_model_render_lod(model, 0);
+}
+
+void sogv_model_render_instanced_lod(sogv_model* model, size_t level, mat4x4* transforms, size_t count) {
+    if(!model->ready || !count) return;
+    sogv_instance_data* data = sogv_instance_scratch(count);
+    for(size_t i=0; i<count; ++i) sogv_instance_fill(&data[i], transforms[i]);
+    sogv_instance_upload(data, count);
+
     for(size_t i=0; i<model->mesh_count; ++i) {
-        glBindTexture(GL_TEXTURE_2D, model->materials[model->meshes[i].mat_idx]);
-        sogv_mesh_render(&model->meshes[i]);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        const sogv_mesh* mesh = &model->meshes[i];
+        const sogv_mesh_lod lod = sogv_mesh_lod_get(mesh, level);
+        sogv_gl_bind_texture(0, model->materials[mesh->mat_idx]);
+        // no instanced multi-draw before GL 4.3, so shared buffers go mesh by mesh too
+        if(model->vao) {
+            const size_t index_size = model->index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(uint);
+            sogv_gl_bind_vao(model->vao);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indice_count, model->index_type,
+                    (const void*)((mesh->first_index + lod.first_index)*index_size), count, mesh->base_vertex);
+        } else {
+            const size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(uint);
+            sogv_gl_bind_vao(mesh->vao);
+            glDrawElementsInstanced(GL_TRIANGLES, lod.indice_count, mesh->index_type,
+                    (const void*)(lod.first_index*index_size), count);
+        }
     }
 }
 
+void sogv_model_render_instanced(sogv_model* model, mat4x4* transforms, size_t count) {
+    sogv_model_render_instanced_lod(model, 0, transforms, count);
+}
+
 void sogv_model_free(sogv_model* model) {
-    for(size_t i=0; i<model->mesh_count; ++i)
+    // Still importing on a worker; sogv_model_load_done frees it once it lands
+    if(model->loading) {
+        model->discarded = true;
+        return;
+    }
+    if(model->uploads_pending) sogv_upload_cancel(model);
+    for(size_t i=0; i<model->mesh_count; ++i) {
+        if(model->blob) model->meshes[i].verts = NULL, model->meshes[i].indices = NULL;
         sogv_mesh_clean(&model->meshes[i]);
+    }
     free(model->meshes);
+    for(size_t i=0; i<model->batch_count*sogv_model_lod_levels(model); ++i) {
+        free(model->batches[i].counts);
+        free(model->batches[i].offsets);
+        free(model->batches[i].base_vertices);
+    }
+    free(model->batches);
+    if(model->vao) {
+        sogv_gl_delete_vertex_arrays(1, &model->vao);
+        sogv_gl_delete_buffers(1, &model->vbo);
+        sogv_gl_delete_buffers(1, &model->ebo);
+    }
+    for(size_t i=0; i<model->mat_count; ++i)
+        sogv_tex_release(model->materials[i]);
     free(model->materials);
-    if(model->root_node) sogv_skel_node_clean(model->root_node);
+    if(model->mat_images) {
+        for(size_t i=0; i<model->mat_count; ++i) sogv_image_free(&model->mat_images[i]);
+        free(model->mat_images);
+    }
+    if(model->blob) {
+        free(model->node_pool);
+        free(model->blob);
+    } else {
+        for(size_t i=0; i<model->mat_count; ++i) free(model->mat_paths[i]);
+        if(model->root_node) sogv_skel_node_clean(model->root_node);
+    }
+    free(model->mat_paths);
 
     free(model);
 }
@@ -0,0 +1,47 @@
+#include <sogv.h>
+
+// Uniform blocks live in the stream ring: each push is a block allocated at the GL offset
+// alignment and bound with glBindBufferRange, so the ring's fences guard them too.
+
+static size_t ubo_align;
+
+sogv_ubo_range sogv_ubo_push(const void* data, size_t size) {
+    if(!ubo_align) {
+        GLint align = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+        ubo_align = align > 0 ? (size_t)align : 256;
+    }
+    sogv_stream_block block = sogv_stream_alloc(size, ubo_align);
+    memcpy(block.ptr, data, size);
+    sogv_stream_flush();
+    return (sogv_ubo_range){
+        .buffer = block.buffer,
+        .offset = block.offset,
+        .size = size,
+    };
+}
+
+void sogv_ubo_bind(GLuint binding, sogv_ubo_range range) {
+    sogv_gl_bind_buffer_range(GL_UNIFORM_BUFFER, binding, range.buffer, range.offset, range.size);
+}
+
+void sogv_ubo_set_frame(const sogv_frame_data* frame) {
+    sogv_ubo_bind(SOGV_UBO_FRAME_BINDING, sogv_ubo_push(frame, sizeof(sogv_frame_data)));
+}
+
+// Bones past count are identity, so stray bone ids with zero weight stay harmless
+sogv_ubo_range sogv_ubo_push_bones(const mat4x4* bones, size_t count) {
+    mat4x4 palette[MAX_BONES];
+    if(count > MAX_BONES) count = MAX_BONES;
+    memcpy(palette, bones, count*sizeof(mat4x4));
+    for(size_t i=count; i<MAX_BONES; ++i) mat4x4_identity(palette[i]);
+    return sogv_ubo_push(palette, sizeof(palette));
+}
+
+void sogv_ubo_program_bind(GLuint program) {
+    GLuint frame = glGetUniformBlockIndex(program, SOGV_UBO_FRAME_BLOCK);
+    if(frame != GL_INVALID_INDEX) glUniformBlockBinding(program, frame, SOGV_UBO_FRAME_BINDING);
+    GLuint bones = glGetUniformBlockIndex(program, SOGV_UBO_BONES_BLOCK);
+    if(bones != GL_INVALID_INDEX) glUniformBlockBinding(program, bones, SOGV_UBO_BONES_BINDING);
+    sogv_gl_check("binding uniform blocks");
+}
@@ -0,0 +1,282 @@
+#include <sogv.h>
+
+// Uniform reflection: sogv_gl_shader_create lists a program's active uniforms once, so lookups
+// are a hash probe instead of a driver call, and handles skip even that. Each program keeps the
+// last value sent to every uniform element; sets that would not change it never reach GL.
+//
+// Handles index into the program's uniform table. "name[i]" handles are added on first lookup
+// and share the value cache of their array, starting at element i.
+
+typedef struct uniform_entry {
+    char* name;
+    GLint location;
+    GLenum type;
+    // elements left from this one to the end of the array
+    GLint size;
+    size_t elem_bytes;
+    // into the program's value cache and known flags
+    size_t cache_off;
+    size_t first_elem;
+} uniform_entry;
+
+typedef struct uniform_program {
+    uniform_entry* entries;
+    size_t entry_count;
+    size_t entry_cap;
+    sogv_name_map by_name;
+    unsigned char* cache;
+    bool* known;
+    size_t elem_count;
+    bool caching;
+    bool reflected;
+    // reads SOGV_ATTR_INSTANCE_MODEL_ID, so draws must come with instance data
+    bool instanced;
+    // reads SOGV_DRAW_TRANSFORMS, so draws can share one multi-draw
+    bool multidraw;
+} uniform_program;
+
+static struct {
+    uniform_program* programs;
+    size_t cap;
+} uniforms;
+
+// Every GL 3.3 uniform type; samplers and bools take ints
+static size_t uniform_elem_bytes(GLenum type) {
+    switch(type) {
+        case GL_FLOAT: case GL_INT: case GL_BOOL: case GL_UNSIGNED_INT:
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW:
+        case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+        case GL_INT_SAMPLER_1D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_RECT:
+        case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D:
+        case GL_UNSIGNED_INT_SAMPLER_CUBE: case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+            return 4;
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: case GL_UNSIGNED_INT_VEC2: return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: case GL_UNSIGNED_INT_VEC3: return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_UNSIGNED_INT_VEC4:
+        case GL_FLOAT_MAT2: return 16;
+        case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 24;
+        case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 32;
+        case GL_FLOAT_MAT3: return 36;
+        case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 48;
+        case GL_FLOAT_MAT4: return 64;
+        default: return 0;
+    }
+}
+
+// Submitted programs are finished and programs linked outside sogv_gl_shader_create are
+// reflected on first use
+static uniform_program* uniform_program_get(GLuint program) {
+    if(program < uniforms.cap && uniforms.programs[program].reflected) return &uniforms.programs[program];
+    if(!program) return NULL;
+    sogv_gl_shader_finish(program);
+    if(program < uniforms.cap && uniforms.programs[program].reflected) return &uniforms.programs[program];
+    if(!glIsProgram(program)) return NULL;
+    sogv_gl_uniforms_reflect(program);
+    return &uniforms.programs[program];
+}
+
+static sogv_uniform uniform_entry_add(uniform_program* prog, uniform_entry entry) {
+    if(prog->entry_count == prog->entry_cap) {
+        prog->entry_cap = prog->entry_cap ? prog->entry_cap*2 : 16;
+        sogv_arr_resize(uniform_entry, prog->entries, prog->entry_cap*sizeof(uniform_entry));
+    }
+    prog->entries[prog->entry_count] = entry;
+    return prog->entry_count++;
+}
+
+void sogv_gl_uniforms_reflect(GLuint program) {
+    if(program >= uniforms.cap) {
+        size_t cap = uniforms.cap ? uniforms.cap : 16;
+        while(cap <= program) cap *= 2;
+        sogv_arr_resize(uniform_program, uniforms.programs, cap*sizeof(uniform_program));
+        memset(&uniforms.programs[uniforms.cap], 0, (cap-uniforms.cap)*sizeof(uniform_program));
+        uniforms.cap = cap;
+    }
+    sogv_gl_uniforms_forget(program);
+    uniform_program* prog = &uniforms.programs[program];
+
+    GLint count = 0, max_len = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_len);
+    char* name = malloc(max_len > 0 ? max_len : 1);
+    if(!name) sogv_die("Could not allocate uniform reflection");
+    sogv_name_map_init(&prog->by_name, count);
+
+    size_t cache_bytes = 0, elems = 0;
+    for(GLint i=0; i<count; ++i) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, max_len, NULL, &size, &type, name);
+        GLint location = glGetUniformLocation(program, name);
+        size_t elem_bytes = uniform_elem_bytes(type);
+        // block members have no location; types past GL 3.3 stay reachable through plain GL
+        if(location < 0 || !elem_bytes) continue;
+        if(strcmp(name, SOGV_DRAW_TRANSFORMS) == 0) prog->multidraw = true;
+
+        // arrays report "name[0]"; both spellings find the array. Struct array members
+        // ("lights[2].pos") are uniforms of their own and keep their full name.
+        size_t len = strlen(name);
+        if(len > 3 && strcmp(name+len-3, "[0]") == 0) name[len-3] = '\0';
+        uniform_entry entry = {
+            .name = strdup(name),
+            .location = location,
+            .type = type,
+            .size = size,
+            .elem_bytes = elem_bytes,
+            .cache_off = cache_bytes,
+            .first_elem = elems,
+        };
+        sogv_name_map_add(&prog->by_name, entry.name, uniform_entry_add(prog, entry));
+        cache_bytes += elem_bytes*size;
+        elems += size;
+    }
+
+    GLint attr_count = 0, attr_len = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attr_count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &attr_len);
+    if(attr_len > max_len) {
+        max_len = attr_len;
+        sogv_arr_resize(char, name, max_len);
+    }
+    for(GLint i=0; i<attr_count; ++i) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(program, i, max_len, NULL, &size, &type, name);
+        if(glGetAttribLocation(program, name) == SOGV_ATTR_INSTANCE_MODEL_ID) prog->instanced = true;
+    }
+    free(name);
+
+    prog->cache = malloc(cache_bytes ? cache_bytes : 1);
+    prog->known = calloc(elems ? elems : 1, sizeof(bool));
+    prog->elem_count = elems;
+    if(!prog->cache || !prog->known) sogv_die("Could not allocate uniform cache");
+    prog->caching = true;
+    prog->reflected = true;
+    sogv_gl_check("reflecting uniforms");
+}
+
+void sogv_gl_uniforms_forget(GLuint program) {
+    if(program >= uniforms.cap) return;
+    uniform_program* prog = &uniforms.programs[program];
+    for(size_t i=0; i<prog->entry_count; ++i) free(prog->entries[i].name);
+    free(prog->entries);
+    free(prog->cache);
+    free(prog->known);
+    sogv_name_map_free(&prog->by_name);
+    memset(prog, 0, sizeof(uniform_program));
+}
+
+sogv_uniform sogv_gl_uniform_find(GLuint program, const char* name) {
+    uniform_program* prog = uniform_program_get(program);
+    if(!prog) return -1;
+    int idx = sogv_name_map_get(&prog->by_name, name);
+    if(idx > -1) return idx;
+
+    // "array[i]": resolve the element once and remember it under its own name
+    const char* bracket = strrchr(name, '[');
+    if(!bracket) return -1;
+    char* end;
+    long elem = strtol(bracket+1, &end, 10);
+    if(end == bracket+1 || *end != ']' || end[1] != '\0' || elem < 0) return -1;
+
+    size_t base_len = bracket - name;
+    char* base = malloc(base_len+1);
+    if(!base) sogv_die("Could not allocate uniform name");
+    memcpy(base, name, base_len);
+    base[base_len] = '\0';
+    int array_idx = sogv_name_map_get(&prog->by_name, base);
+    free(base);
+    if(array_idx < 0 || elem >= prog->entries[array_idx].size) return -1;
+    if(elem == 0) return array_idx;
+
+    uniform_entry entry = prog->entries[array_idx];
+    entry.name = strdup(name);
+    entry.location = glGetUniformLocation(program, name);
+    entry.size -= elem;
+    entry.cache_off += elem*entry.elem_bytes;
+    entry.first_elem += elem;
+    if(entry.location < 0) {
+        free(entry.name);
+        return -1;
+    }
+    sogv_uniform u = uniform_entry_add(prog, entry);
+    sogv_name_map_add(&prog->by_name, prog->entries[u].name, u);
+    return u;
+}
+
+bool sogv_gl_program_instanced(GLuint program) {
+    uniform_program* prog = uniform_program_get(program);
+    return prog && prog->instanced;
+}
+
+bool sogv_gl_program_multidraw(GLuint program) {
+    uniform_program* prog = uniform_program_get(program);
+    return prog && prog->multidraw;
+}
+
+void sogv_gl_uniform_cache_enable(GLuint program, bool enabled) {
+    uniform_program* prog = uniform_program_get(program);
+    if(!prog) return;
+    prog->caching = enabled;
+    // values set while disabled were not recorded
+    if(enabled) memset(prog->known, 0, prog->elem_count*sizeof(bool));
+}
+
+// Values are in the uniform's own type: floats for float types, unsigned ints for uint types,
+// ints for int, bool and sampler uniforms. The program must be current.
+void sogv_gl_uniform_set(GLuint program, sogv_uniform u, GLsizei count, const void* value) {
+    uniform_program* prog = uniform_program_get(program);
+    if(!prog || u < 0 || (size_t)u >= prog->entry_count || count < 1) return;
+    const uniform_entry* entry = &prog->entries[u];
+    if(count > entry->size) count = entry->size;
+
+    if(prog->caching) {
+        const size_t bytes = entry->elem_bytes*count;
+        bool* known = &prog->known[entry->first_elem];
+        bool all_known = true;
+        for(GLsizei i=0; i<count && all_known; ++i) all_known = known[i];
+        if(all_known && memcmp(prog->cache + entry->cache_off, value, bytes) == 0) return;
+        memcpy(prog->cache + entry->cache_off, value, bytes);
+        memset(known, true, count*sizeof(bool));
+    }
+
+    const GLint loc = entry->location;
+    switch(entry->type) {
+        case GL_FLOAT: glUniform1fv(loc, count, value); break;
+        case GL_FLOAT_VEC2: glUniform2fv(loc, count, value); break;
+        case GL_FLOAT_VEC3: glUniform3fv(loc, count, value); break;
+        case GL_FLOAT_VEC4: glUniform4fv(loc, count, value); break;
+        case GL_FLOAT_MAT2: glUniformMatrix2fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT3: glUniformMatrix3fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT4: glUniformMatrix4fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(loc, count, GL_FALSE, value); break;
+        case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(loc, count, GL_FALSE, value); break;
+        case GL_INT_VEC2: case GL_BOOL_VEC2: glUniform2iv(loc, count, value); break;
+        case GL_INT_VEC3: case GL_BOOL_VEC3: glUniform3iv(loc, count, value); break;
+        case GL_INT_VEC4: case GL_BOOL_VEC4: glUniform4iv(loc, count, value); break;
+        case GL_UNSIGNED_INT: glUniform1uiv(loc, count, value); break;
+        case GL_UNSIGNED_INT_VEC2: glUniform2uiv(loc, count, value); break;
+        case GL_UNSIGNED_INT_VEC3: glUniform3uiv(loc, count, value); break;
+        case GL_UNSIGNED_INT_VEC4: glUniform4uiv(loc, count, value); break;
+        // int, bool and every sampler
+        default: glUniform1iv(loc, count, value); break;
+    }
+}
+
+void sogv_gl_uniform_set_by_name(GLuint program, const char* name, GLsizei count, const void* value) {
+    sogv_gl_uniform_set(program, sogv_gl_uniform_find(program, name), count, value);
+}
@@ -0,0 +1,382 @@
+#include <sogv.h>
+
+typedef enum {UPLOAD_BUFFER, UPLOAD_TEXTURE} upload_kind;
+
+// A material of another model that uses a texture still streaming
+typedef struct upload_wait {
+    sogv_model* model;
+    size_t mat_idx;
+    struct upload_wait* next;
+} upload_wait;
+
+// Textures enter the texture cache only once their last row or level is up. Until then other
+// models find them here, by path, and wait for them instead of drawing a half filled texture.
+typedef struct upload_item {
+    upload_kind kind;
+    sogv_model* model;
+    GLuint name;
+    const unsigned char* src;
+    size_t size;
+    size_t done;
+    // buffers only: where src lands in the buffer
+    size_t dst_off;
+    // textures only
+    size_t mat_idx;
+    size_t row_bytes;
+    int rows_done;
+    upload_wait* waiters;
+    struct upload_item* next;
+} upload_item;
+
+static struct {
+    bool active;
+    size_t bytes_per_frame;
+    float ms_per_frame;
+    GLuint* pbos;
+    GLsync* fences;
+    size_t pbo_count;
+    size_t pbo_size;
+    size_t pbo_next;
+    upload_item* head;
+    upload_item* tail;
+} up;
+
+void sogv_upload_init(size_t bytes_per_frame, float ms_per_frame, size_t pbo_count, size_t pbo_size) {
+    if(up.active) return;
+    up.bytes_per_frame = bytes_per_frame;
+    up.ms_per_frame = ms_per_frame;
+    up.pbo_count = pbo_count;
+    up.pbo_size = pbo_size;
+    up.pbo_next = 0;
+    up.pbos = calloc(pbo_count, sizeof(GLuint));
+    up.fences = calloc(pbo_count, sizeof(GLsync));
+
+    glGenBuffers(pbo_count, up.pbos);
+    for(size_t i=0; i<pbo_count; ++i) {
+        sogv_gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, up.pbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo_size, NULL, GL_STREAM_DRAW);
+    }
+    sogv_gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    sogv_gl_check("creating upload pixel buffers");
+    up.active = true;
+}
+
+static size_t upload_step(upload_item* item, size_t budget);
+
+// Whatever is still queued goes up now, straight from client memory, so every model ends
+// up ready and every decoded image freed
+void sogv_upload_quit() {
+    if(!up.active) return;
+    for(size_t i=0; i<up.pbo_count; ++i)
+        if(up.fences[i]) glDeleteSync(up.fences[i]);
+    sogv_gl_delete_buffers(up.pbo_count, up.pbos);
+    free(up.pbos);
+    free(up.fences);
+    up.pbos = NULL;
+    up.fences = NULL;
+    up.pbo_count = 0;
+    while(up.head) upload_step(up.head, SIZE_MAX);
+    up.active = false;
+}
+
+static void upload_push(upload_kind kind, sogv_model* model, GLuint name, const void* src, size_t size) {
+    upload_item* item = calloc(1, sizeof(upload_item));
+    if(!item) sogv_die("Could not allocate upload item");
+    item->kind = kind;
+    item->model = model;
+    item->name = name;
+    item->src = src;
+    item->size = size;
+    if(up.tail) up.tail->next = item;
+    else up.head = item;
+    up.tail = item;
+    model->uploads_pending++;
+}
+
+static upload_item* upload_texture_find(const char* path) {
+    for(upload_item* item = up.head; item; item = item->next)
+        if(item->kind == UPLOAD_TEXTURE && strcmp(item->model->mat_paths[item->mat_idx], path) == 0)
+            return item;
+    return NULL;
+}
+
+static void upload_wait_add(upload_item* item, sogv_model* model, size_t mat_idx) {
+    upload_wait* wait = malloc(sizeof(upload_wait));
+    if(!wait) sogv_die("Could not allocate upload wait");
+    wait->model = model;
+    wait->mat_idx = mat_idx;
+    wait->next = item->waiters;
+    item->waiters = wait;
+    // no reference yet, the waiter gets one when the texture enters the cache
+    model->materials[mat_idx] = item->name;
+    model->uploads_pending++;
+}
+
+void sogv_upload_model(sogv_model* model) {
+    if(!up.active) {
+        sogv_model_upload(model);
+        return;
+    }
+
+    if(model->batches) {
+        sogv_model_glize_shared_storage(model);
+        const bool narrow = model->index_type == GL_UNSIGNED_SHORT;
+        const size_t index_size = narrow ? sizeof(unsigned short) : sizeof(uint);
+        for(size_t i=0; i<model->mesh_count; ++i) {
+            const sogv_mesh* mesh = &model->meshes[i];
+            const size_t stride = mesh->packed ? sizeof(sogv_vert_packed) : sizeof(sogv_vert);
+            upload_push(UPLOAD_BUFFER, model, model->vbo, mesh->packed ? (const void*)mesh->packed : (const void*)mesh->verts,
+                    mesh->vert_count*stride);
+            up.tail->dst_off = mesh->base_vertex*stride;
+            upload_push(UPLOAD_BUFFER, model, model->ebo, narrow ? (const void*)mesh->short_indices : (const void*)mesh->indices,
+                    sogv_mesh_index_total(mesh)*index_size);
+            up.tail->dst_off = mesh->first_index*index_size;
+        }
+    } else for(size_t i=0; i<model->mesh_count; ++i) {
+        sogv_mesh* mesh = &model->meshes[i];
+        sogv_mesh_glize_storage(mesh);
+        if(mesh->packed)
+            upload_push(UPLOAD_BUFFER, model, mesh->vbo, mesh->packed, mesh->vert_count*sizeof(sogv_vert_packed));
+        else
+            upload_push(UPLOAD_BUFFER, model, mesh->vbo, mesh->verts, mesh->vert_count*sizeof(sogv_vert));
+        if(mesh->index_type == GL_UNSIGNED_SHORT)
+            upload_push(UPLOAD_BUFFER, model, mesh->ebo, mesh->short_indices, sogv_mesh_index_total(mesh)*sizeof(unsigned short));
+        else
+            upload_push(UPLOAD_BUFFER, model, mesh->ebo, mesh->indices, sogv_mesh_index_total(mesh)*sizeof(uint));
+    }
+
+    for(size_t i=0; i<model->mat_count; ++i) {
+        const sogv_image* img = &model->mat_images[i];
+        if(!model->mat_paths[i]) continue;
+        upload_item* streaming;
+        if((model->materials[i] = sogv_tex_ref(model->mat_paths[i]))) {
+            sogv_image_free(&model->mat_images[i]);
+            continue;
+        }
+        if((streaming = upload_texture_find(model->mat_paths[i]))) {
+            upload_wait_add(streaming, model, i);
+            sogv_image_free(&model->mat_images[i]);
+            continue;
+        }
+        // shared with a model that was not decoding it after all, or evicted since decode
+        if(!img->data) {
+            model->materials[i] = sogv_tex_acquire(model->mat_paths[i], model->flags & SOGV_MODEL_FLIP_TEXTURES);
+            continue;
+        }
+
+        glGenTextures(1, &model->materials[i]);
+        sogv_gl_bind_texture(0, model->materials[i]);
+
+        // compressed textures go up a whole mip level per step, straight from client memory
+        if(img->format) {
+            size_t size = 0;
+            for(int l=0; l<img->levels; ++l) size += sogv_image_level_size(img, l);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, img->levels-1);
+            upload_push(UPLOAD_TEXTURE, model, model->materials[i], img->data, size);
+            up.tail->mat_idx = i;
+            continue;
+        }
+
+        GLenum f = img->n == 1 ? GL_RED : img->n == 3 ? GL_RGB : GL_RGBA;
+        glTexImage2D(GL_TEXTURE_2D, 0, f, img->w, img->h, 0, f, GL_UNSIGNED_BYTE, NULL);
+        sogv_gl_check("allocating streamed texture");
+
+        upload_push(UPLOAD_TEXTURE, model, model->materials[i], img->data, (size_t)img->w*img->h*img->n);
+        up.tail->mat_idx = i;
+        up.tail->row_bytes = (size_t)img->w*img->n;
+    }
+
+    if(!model->uploads_pending) model->ready = true;
+}
+
+// A cancelled model's streaming textures go on for the first model waiting on them, which
+// takes over the decoded image; with nobody waiting they are dropped with the model.
+void sogv_upload_cancel(sogv_model* model) {
+    for(upload_item* item = up.head; item; item = item->next) {
+        upload_wait** wait_link = &item->waiters;
+        while(*wait_link) {
+            upload_wait* wait = *wait_link;
+            if(wait->model != model) {
+                wait_link = &wait->next;
+                continue;
+            }
+            // holds no reference, so sogv_model_free must not release it
+            model->materials[wait->mat_idx] = 0;
+            *wait_link = wait->next;
+            free(wait);
+        }
+    }
+
+    upload_item** link = &up.head;
+    up.tail = NULL;
+    while(*link) {
+        upload_item* item = *link;
+        if(item->model == model && item->waiters) {
+            upload_wait* heir = item->waiters;
+            item->waiters = heir->next;
+            heir->model->mat_images[heir->mat_idx] = model->mat_images[item->mat_idx];
+            memset(&model->mat_images[item->mat_idx], 0, sizeof(sogv_image));
+            model->materials[item->mat_idx] = 0;
+            // the heir's wait turns into the item itself
+            item->model = heir->model;
+            item->mat_idx = heir->mat_idx;
+            free(heir);
+        }
+        if(item->model == model) {
+            *link = item->next;
+            free(item);
+        } else {
+            up.tail = item;
+            link = &item->next;
+        }
+    }
+    model->uploads_pending = 0;
+}
+
+static void upload_model_done(sogv_model* model) {
+    if(--model->uploads_pending == 0) model->ready = true;
+}
+
+// Last row or level is up: into the cache with a reference for each waiter
+static void upload_texture_resident(upload_item* item) {
+    const char* path = item->model->mat_paths[item->mat_idx];
+    sogv_tex_insert(path, item->name);
+    while(item->waiters) {
+        upload_wait* wait = item->waiters;
+        item->waiters = wait->next;
+        sogv_tex_ref(path);
+        upload_model_done(wait->model);
+        free(wait);
+    }
+}
+
+static size_t upload_buffer_step(upload_item* item, size_t budget) {
+    size_t len = item->size - item->done;
+    if(len > budget) len = budget;
+
+    // COPY_WRITE keeps the upload from touching whatever VAO is bound
+    sogv_gl_bind_buffer(GL_COPY_WRITE_BUFFER, item->name);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, item->dst_off + item->done, len, item->src + item->done);
+    item->done += len;
+    return len;
+}
+
+// rows_done counts mip levels for compressed textures
+static size_t upload_compressed_step(upload_item* item) {
+    const sogv_image* img = &item->model->mat_images[item->mat_idx];
+    int l = item->rows_done;
+    int w = img->w >> l, h = img->h >> l;
+    size_t len = sogv_image_level_size(img, l);
+
+    sogv_gl_bind_texture(0, item->name);
+    glCompressedTexImage2D(GL_TEXTURE_2D, l, img->format, w ? w : 1, h ? h : 1, 0, len, item->src + item->done);
+    sogv_gl_check("streaming compressed texture level");
+
+    item->rows_done++;
+    item->done += len;
+    if(item->rows_done == img->levels) {
+        sogv_gl_tex_parameterize(GL_TEXTURE_2D, GL_REPEAT,
+                img->levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR);
+        sogv_image_free(&item->model->mat_images[item->mat_idx]);
+        upload_texture_resident(item);
+    }
+    return len;
+}
+
+// Copies a band of rows into the next free pixel buffer and points glTexSubImage2D at it.
+// Returns 0 without waiting if the ring is still busy with earlier bands.
+static size_t upload_texture_step(upload_item* item, size_t budget) {
+    const sogv_image* img = &item->model->mat_images[item->mat_idx];
+    if(img->format) return upload_compressed_step(item);
+    GLenum f = img->n == 1 ? GL_RED : img->n == 3 ? GL_RGB : GL_RGBA;
+    size_t rows_left = img->h - item->rows_done;
+    size_t rows = budget / item->row_bytes;
+    if(rows < 1) rows = 1;
+    if(rows > rows_left) rows = rows_left;
+
+    sogv_gl_bind_texture(0, item->name);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if(item->row_bytes <= up.pbo_size && up.pbo_count) {
+        size_t slot = up.pbo_next;
+        if(up.fences[slot]) {
+            if(glClientWaitSync(up.fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                return 0;
+            }
+            glDeleteSync(up.fences[slot]);
+            up.fences[slot] = NULL;
+        }
+        if(rows*item->row_bytes > up.pbo_size) rows = up.pbo_size / item->row_bytes;
+
+        size_t len = rows*item->row_bytes;
+        sogv_gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, up.pbos[slot]);
+        void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, len,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(dst) {
+            memcpy(dst, item->src + item->done, len);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, item->rows_done, img->w, rows, f, GL_UNSIGNED_BYTE, (void*)0);
+            up.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            up.pbo_next = (slot+1) % up.pbo_count;
+        }
+        sogv_gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if(!dst) {
+            sogv_gl_check("mapping upload pixel buffer");
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, item->rows_done, img->w, rows, f, GL_UNSIGNED_BYTE,
+                    item->src + item->done);
+        }
+    } else {
+        // rows wider than a pixel buffer go straight from client memory
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, item->rows_done, img->w, rows, f, GL_UNSIGNED_BYTE,
+                item->src + item->done);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    sogv_gl_check("streaming texture rows");
+
+    item->rows_done += rows;
+    item->done += rows*item->row_bytes;
+    if(item->rows_done == img->h) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        sogv_gl_tex_parameterize(GL_TEXTURE_2D, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+        sogv_image_free(&item->model->mat_images[item->mat_idx]);
+        upload_texture_resident(item);
+    }
+    return rows*item->row_bytes;
+}
+
+// One step of the head item, which leaves the queue once done
+static size_t upload_step(upload_item* item, size_t budget) {
+    size_t len = item->kind == UPLOAD_BUFFER ?
+        upload_buffer_step(item, budget) : upload_texture_step(item, budget);
+    if(item->done == item->size) {
+        up.head = item->next;
+        if(!up.head) up.tail = NULL;
+        upload_model_done(item->model);
+        free(item);
+    }
+    return len;
+}
+
+size_t sogv_upload_frame() {
+    if(!up.active) return 0;
+
+    const uint64_t start = SDL_GetPerformanceCounter();
+    const uint64_t ticks_budget = up.ms_per_frame > 0.0f ?
+        up.ms_per_frame * SDL_GetPerformanceFrequency() / 1000.0f : 0;
+    size_t spent = 0;
+
+    while(up.head) {
+        if(up.bytes_per_frame && spent >= up.bytes_per_frame) break;
+        if(ticks_budget && SDL_GetPerformanceCounter() - start >= ticks_budget) break;
+
+        size_t budget = up.bytes_per_frame ? up.bytes_per_frame - spent : SIZE_MAX;
+
+        upload_item* item = up.head;
+        size_t len = upload_step(item, budget);
+        // a busy pixel buffer ring; item is still the head then
+        if(len == 0 && up.head == item) break;
+        spent += len;
+    }
+    return spent;
+}